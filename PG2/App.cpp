@@ -3,15 +3,17 @@
 #include <chrono>
 #include <stack>
 #include <random>
-#include <sstream>
+#include <cstdio>
+#include <ctime>
 
 // OpenCV  GL independent
-#include <opencv2/opencv.hpp>
 
 // OpenGL Extension Wrangler: allow all multiplatform GL functions
 #include <GL/glew.h> 
 // WGLEW = Windows GL Extension Wrangler :: platform specific functions (in this case Windows)
+#ifdef _WIN32
 #include <GL/wglew.h> 
+#endif
 
 // GLFW toolkit
 // Uses GL calls to open GL context, i.e. GLEW must be first.
@@ -24,7 +26,9 @@
 // Our app
 #include "App.hpp"
 #include "gl_err_callback.hpp"
+#include "Profiler.hpp"
 #include "ShaderProgram.hpp"
+#include "Texture.hpp"
 
 #define print(x)// std::cout << x << "\n"
 
@@ -37,23 +41,34 @@ App::App()
 bool App::Init()
 {
     try {        
+        PROFILE_THREAD("Main");
+        PROFILE_ZONE("App::Init");
+
         // Set GLFW error callback
         glfwSetErrorCallback(error_callback);
 
+        // Headless software or EGL context :: no display needed at all (GLFW 3.4+, older ones need some X server, e.g. xvfb-run)
+#ifdef GLFW_PLATFORM_NULL
+        if (headless.is_on && headless.context_api != GLFW_NATIVE_CONTEXT_API) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
         // Init GLFW :: https://www.glfw.org/documentation.html
         if (!glfwInit()) {
             return false;
         }
 
-        // Set OpenGL version
+        // Set OpenGL version :: 4.5 is all we need (drivers give the newest one anyway), Mesa llvmpipe of the headless mode stops there
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
         // Set OpenGL profile
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Core, comment this line for Compatible
         
         // Window is hidden until everything is initialized
         glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
+        // Headless :: the window is never shown, the context is the usual WGL/GLX one unless software or EGL is asked for
+        if (headless.is_on && headless.context_api != GLFW_NATIVE_CONTEXT_API) glfwWindowHint(GLFW_CONTEXT_CREATION_API, headless.context_api);
+
         // Open window (GL canvas) with no special properties :: https://www.glfw.org/docs/latest/quick.html#quick_create_window
         window = glfwCreateWindow(window_width, window_height, "Moje krasne okno", NULL, NULL);
         if (!window) {
@@ -78,16 +93,25 @@ bool App::Init()
         glfwSetCursorPosCallback(window, cursor_position_callback);
         glfwSetScrollCallback(window, scroll_callback);
 
-        // Set V-Sync ON.
-        glfwSwapInterval(1);
-        is_vsync_on = true;
+        // Set V-Sync ON (headless never swaps, a stress run measures the scene and not the display; no mouselook headless)
+        is_vsync_on = !headless.is_on && !stress.is_on;
+        glfwSwapInterval(is_vsync_on);
+        if (headless.is_on) is_mouselook_on = false;
 
         // Init GLEW :: http://glew.sourceforge.net/basic.html
         GLenum err = glewInit();
         if (GLEW_OK != err) {
-            fprintf(stderr, "Error: %s\n", glewGetErrorString(err)); /* Problem: glewInit failed, something is seriously wrong. */
+            // No entry points, first GL call would crash; osmesa/egl headless contexts need a GLEW built for them (see README)
+            fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
+            throw std::exception("glewInit failed\n");
         }
+#ifdef _WIN32
         wglewInit();
+#endif
+
+        // Let the driver compile shaders on as many threads as it likes
+        if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
 
         //...after ALL GLFW & GLEW init ...
         if (GLEW_ARB_debug_output)
@@ -114,10 +138,22 @@ bool App::Init()
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         
         // First init OpenGL, THAN init assets: valid context MUST exist
+        texture_streamer.Init();
+        TextureSetStreamer(&texture_streamer);
+        image_decoder.Start();
+        TextureSetDecoder(&image_decoder);
         InitAssets();
-
-        // Show window after everything loads        
-        glfwShowWindow(window);
+        TextureSetDecoder(nullptr);
+        image_decoder.Stop();
+        oit.Init(window_width, window_height);
+        occlusion_culler.Init();
+        clustered_lights.Init();
+        gpu_profiler.Init();
+        shader_watcher.Start("./resources/shaders");
+
+        // Show window after everything loads, headless renders offscreen
+        if (headless.is_on) offscreen.Init(window_width, window_height);
+        else glfwShowWindow(window);
     }
     catch (std::exception const& e) {
         std::cerr << "Init failed : " << e.what() << "\n";
@@ -133,10 +169,6 @@ int App::Run(void)
         double current_timestamp = glfwGetTime();
         double last_frame_time = current_timestamp;
 
-        // FPS counting
-        double fps_counter_seconds = 0;
-        int fps_counter_frames = 0;
-
         // Init view
         UpdateProjectionMatrix();
         glViewport(0, 0, window_width, window_height);
@@ -146,9 +178,7 @@ int App::Run(void)
         camera.position.y = 1.0f;
         camera.position.z = 1.0f;
         glm::vec3 camera_movement{};
-
-        // Mouselook
-        double cursor_x, cursor_y;
+        InputFrame input;
 
         // Walking sound
         double walk_last_played_timestamp = current_timestamp;
@@ -164,21 +194,41 @@ int App::Run(void)
 
         // Main loop
         while (!glfwWindowShouldClose(window)) {
+            PROFILE_ZONE("Frame");
+            gpu_profiler.BeginFrame();
+            if (headless.is_on) offscreen.Bind();
             current_timestamp = glfwGetTime();
 
-            // Time/FPS measure start
-            auto fps_frame_start_timestamp = std::chrono::steady_clock::now();
+            // Frame time measure start
+            auto frame_start_timestamp = std::chrono::steady_clock::now();
+
+            // Shader hot reload, never waits for the compiler
+            UpdateShaders();
+
+            // Next part of texture mip levels, coarse ones first
+            GPUProfilerZone streaming_gpu_zone(gpu_profiler, "Texture streaming");
+            texture_streamer.Update(texture_table);
+            streaming_gpu_zone.End();
 
             // Clear OpenGL canvas, both color buffer and Z-buffer
             glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // === After clearing the canvas ===
-            float delta_time = static_cast<float>(current_timestamp - last_frame_time);
+            // Input of this frame, live or replayed with the recorded delta time
+            ProfilerZone input_zone("Input");
+            if (!input_recorder.NextFrame(window, current_timestamp, static_cast<float>(current_timestamp - last_frame_time), is_mouselook_on, glm::dvec2(window_width / 2.0, window_height / 2.0), input)) {
+                glfwSetWindowShouldClose(window, GLFW_TRUE); // Replay is over
+                break;
+            }
             last_frame_time = current_timestamp;
+            float delta_time = input.delta_time;
+            scene_time += delta_time;
+            if (input_recorder.IsReplaying()) is_mouselook_on = input.is_mouselook_on;
+            for (const auto& event : input.events) HandleInputEvent(event);
             
             // Player movement
-            camera_movement = camera.ProcessInput(window, delta_time);
+            camera_movement = camera.ProcessInput(input);
             camera.position.x += camera_movement.x;
             camera.position.z += camera_movement.z;
 
@@ -194,12 +244,8 @@ int App::Run(void)
                 walk_last_played_timestamp = current_timestamp; // Consistent delay for first step sound after movement starts
             }
 
-            // Mouselook  get cursor's offset from window center and the move it back to center
-            if (is_mouselook_on) {
-                glfwGetCursorPos(window, &cursor_x, &cursor_y);
-                camera.ProcessMouseMovement(static_cast<GLfloat>(window_width / 2.0 - cursor_x), static_cast<GLfloat>(window_height / 2.0 - cursor_y));
-                glfwSetCursorPos(window, window_width / 2.0, window_height / 2.0);
-            }
+            // Mouselook  cursor's offset from window center, taken by the input recorder
+            camera.ProcessMouseMovement(input.look.x, input.look.y); // Zero without mouselook
 
             // Heightmap collision  for our X and Z get Y coordinate for ground level
             auto heightmap_y = GetHeightmapY(camera.position.x, camera.position.z);
@@ -230,122 +276,213 @@ int App::Run(void)
                 }
             }
             audio.UpdateJetpackVolume(camera_movement.y > 0.0f);
+            input_zone.End();
 
             // Create View Matrix according to camera settings
             glm::mat4 mx_view = camera.GetViewMatrix();            
+            mx_view_projection = mx_projection * mx_view;
+
+            // Rasterize static occluders in parallel with the update
+            if (is_software_occlusion_on) software_occlusion_culler.BeginRasterize(mx_view_projection);
 
             // Update objects
             jukebox_to_player.x = camera.position.x - obj_jukebox->position.x;
             jukebox_to_player.y = camera.position.z - obj_jukebox->position.z;
             jukebox_to_player_n = glm::normalize(jukebox_to_player);
             UpdateModels(delta_time);
+            if (stress.is_on) UpdateStress(delta_time);
             UpdateProjectiles(delta_time);
 
+            // Skip objects outside of the view frustum and behind occluders
+            CullScene(mx_view_projection);
+            if (is_software_occlusion_on) CullOccludedModels();
+
+            // Restore what became visible, evict what was not seen for the longest time if over the GPU memory budget
+            residency_manager.Update(texture_table, texture_streamer);
+
+            // Terrain pages needed from here, loaded ones go to the cache
+            virtual_texture.Update(mx_view_projection, camera.position, FOV, window_height);
+
             // 3D Audio
             camera.UpdateListenerPosition(audio);
             audio.UpdateMusicPosition(obj_jukebox->position);
 
-            // Activate shader
-            my_shader.Activate();
+            // Activate shader :: permutation with only the lights that are on
+            ProfilerZone uniforms_zone("Uniforms");
+            ShaderProgram& uber_shader = GetUberShader();
+            uber_shader.Activate();
+            texture_table.Bind(uber_shader);
+            virtual_texture.Bind(uber_shader);
 
             // Set shader uniform variables
-            my_shader.SetUniform("u_mx_view", mx_view); // World space -> Camera space
-            my_shader.SetUniform("u_mx_projection", mx_projection); // Camera space -> Screen
+            uber_shader.SetUniform("u_mx_view_projection", mx_view_projection); // World space -> Screen
 
             // UBER
-            my_shader.SetUniform("u_ambient_alpha", 0.0f);
-            my_shader.SetUniform("u_diffuse_alpha", 0.7f);
-            my_shader.SetUniform("u_camera_position", camera.position);
+            uber_shader.SetUniform("u_ambient_alpha", 0.0f);
+            uber_shader.SetUniform("u_diffuse_alpha", 0.7f);
+            uber_shader.SetUniform("u_oit", 0);
+            uber_shader.SetUniform("u_camera_position", camera.position);
 
             // - AMBIENT
-            my_shader.SetUniform("u_material.ambient", glm::vec3(0.1f));
+            uber_shader.SetUniform("u_material.ambient", glm::vec3(0.1f));
 
             // - MATERIAL SPECULAR
-            my_shader.SetUniform("u_material.specular", glm::vec3(1.0f));
-            my_shader.SetUniform("u_material.shininess", 96.0f);
+            uber_shader.SetUniform("u_material.specular", glm::vec3(1.0f));
+            uber_shader.SetUniform("u_material.shininess", 96.0f);
 
             // - DIRECTION :: SUN O)))
-            my_shader.SetUniform("u_directional_light.direction", glm::vec3(0.0f, -0.9f, -0.17f));
-            my_shader.SetUniform("u_directional_light.diffuse", glm::vec3(0.8f));
-            my_shader.SetUniform("u_directional_light.specular", glm::vec3(0.14f));
-
-            // - POINT LIGHT :: JUKEBOX
-            my_shader.SetUniform("u_point_lights[0].diffuse", glm::vec3(0.0f, 1.0f, 1.0f));
-            my_shader.SetUniform("u_point_lights[0].specular", glm::vec3(0.07f));
-            my_shader.SetUniform("u_point_lights[0].on", is_jukebox_on);
-            glm::vec3 point_light_pos = obj_jukebox->position; // Light position infront of the jukebox
-            point_light_pos.y += 1.0f;
-            point_light_pos.x += 0.7f * jukebox_to_player_n.x;
-            point_light_pos.z += 0.7f * jukebox_to_player_n.y;
-            my_shader.SetUniform("u_point_lights[0].position", point_light_pos);
-            my_shader.SetUniform("u_point_lights[0].constant", 1.0f);
-            my_shader.SetUniform("u_point_lights[0].linear", 1.0f);
-            my_shader.SetUniform("u_point_lights[0].exponent", 0.5f);
+            uber_shader.SetUniform("u_directional_light.direction", glm::vec3(0.0f, -0.9f, -0.17f));
+            uber_shader.SetUniform("u_directional_light.diffuse", glm::vec3(0.8f));
+            uber_shader.SetUniform("u_directional_light.specular", glm::vec3(0.14f));
+
+            // - POINT LIGHTS :: binned into clusters, each fragment evaluates only nearby ones
+            clustered_lights.BeginFrame();
+            // - - JUKEBOX
+            if (is_jukebox_on) {
+                ClusteredLights::PointLight light;
+                light.diffuse = glm::vec3(0.0f, 1.0f, 1.0f);
+                light.specular = glm::vec3(0.07f);
+                light.position = obj_jukebox->position; // Light position infront of the jukebox
+                light.position.y += 1.0f;
+                light.position.x += 0.7f * jukebox_to_player_n.x;
+                light.position.z += 0.7f * jukebox_to_player_n.y;
+                light.constant = 1.0f;
+                light.linear = 1.0f;
+                light.exponent = 0.5f;
+                clustered_lights.AddLight(light);
+            }
+            // - - PROJECTILES :: glowing while flying
+            for (size_t i = 0; i < projectiles.size(); i++) {
+                if (!is_projectile_moving[i]) continue;
+                ClusteredLights::PointLight light;
+                light.position = projectiles[i]->position;
+                light.diffuse = glm::vec3(1.0f, 0.6f, 0.2f);
+                light.specular = glm::vec3(0.2f);
+                light.constant = 1.0f;
+                light.linear = 0.7f;
+                light.exponent = 1.8f;
+                clustered_lights.AddLight(light);
+            }
+            // - - STRESS :: moving lights
+            if (stress.is_on) AddStressLights();
+            clustered_lights.Update(mx_view, mx_projection, CAMERA_NEAR, CAMERA_FAR);
+            clustered_lights.Bind(uber_shader, window_width, window_height);
 
             // - SPOTLIGHT
-            my_shader.SetUniform("u_spotlight.diffuse", glm::vec3(0.7f));
-            my_shader.SetUniform("u_spotlight.specular", glm::vec3(0.56f));
-            my_shader.SetUniform("u_spotlight.position", camera.position);
-            my_shader.SetUniform("u_spotlight.direction", camera.front);
-            my_shader.SetUniform("u_spotlight.cos_inner_cone", glm::cos(glm::radians(20.0f)));
-            my_shader.SetUniform("u_spotlight.cos_outer_cone", glm::cos(glm::radians(27.0f)));
-            my_shader.SetUniform("u_spotlight.constant", 1.0f);
-            my_shader.SetUniform("u_spotlight.linear", 0.07f);
-            my_shader.SetUniform("u_spotlight.exponent", 0.017f);
-            my_shader.SetUniform("u_spotlight.on", is_flashlight_on);
+            if (is_flashlight_on) {
+                uber_shader.SetUniform("u_spotlight.diffuse", glm::vec3(0.7f));
+                uber_shader.SetUniform("u_spotlight.specular", glm::vec3(0.56f));
+                uber_shader.SetUniform("u_spotlight.position", camera.position);
+                uber_shader.SetUniform("u_spotlight.direction", camera.front);
+                uber_shader.SetUniform("u_spotlight.cos_inner_cone", glm::cos(glm::radians(20.0f)));
+                uber_shader.SetUniform("u_spotlight.cos_outer_cone", glm::cos(glm::radians(27.0f)));
+                uber_shader.SetUniform("u_spotlight.constant", 1.0f);
+                uber_shader.SetUniform("u_spotlight.linear", 0.07f);
+                uber_shader.SetUniform("u_spotlight.exponent", 0.017f);
+            }
+            uniforms_zone.End();
             
             // Draw the scene
-            // - Draw opaque objects
-            for (auto& [key, value] : scene_opaque) {
-                value->Draw(my_shader);
+            // - Sort opaque objects by their distance from camera (near to far)
+            ProfilerZone opaque_zone("Opaque");
+            scene_opaque_sorted.Sort(camera.position);
+            occlusion_culler.BeginFrame();
+            // - Depth pre-pass :: only depth of opaque objects, lit pass then shades only the visible fragments
+            if (is_depth_prepass_on) {
+                GPUProfilerZone prepass_gpu_zone(gpu_profiler, "Depth pre-pass");
+                depth_shader.Activate();
+                depth_shader.SetUniform("u_mx_view_projection", mx_view_projection);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                DrawModels(scene_opaque_sorted, depth_shader, true, true);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+                uber_shader.Activate();
             }
+            // - Draw opaque objects
+            GPUProfilerZone opaque_gpu_zone(gpu_profiler, "Opaque");
+            DrawModels(scene_opaque_sorted, uber_shader, false, !is_depth_prepass_on);
+            opaque_gpu_zone.End();
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+            opaque_zone.End();
             // - Draw transparent objects
+            ProfilerZone transparent_zone("Transparent");
+            GPUProfilerZone transparent_gpu_zone(gpu_profiler, "Transparent");
             glEnable(GL_BLEND);         // enable blending
             glDisable(GL_CULL_FACE);    // no polygon removal
             glDepthMask(GL_FALSE);      // set Z to read-only
-            // - - Calculate distace from camera for all transparent objects
-            for (auto& transparent_pair : scene_transparent_pairs) {
-                transparent_pair->second->_distance_from_camera = glm::length(camera.position - transparent_pair->second->position);
+            if (is_oit_on) {
+                // - - Draw all transparent objects in any order, then composite them
+                oit.Begin();
+                uber_shader.SetUniform("u_oit", 1);
+                DrawModels(scene_transparent_sorted, uber_shader, false, true); // Order of the list doesn't matter here
+                GPUProfilerZone composite_gpu_zone(gpu_profiler, "OIT composite");
+                oit.End();
             }
-            // - - Sort all transparent objects in vector by their distance from camera (far to near)
-			std::sort(scene_transparent_pairs.begin(), scene_transparent_pairs.end(), [](std::pair<const std::string, Model*>*& a, std::pair<const std::string, Model*>*& b) {
-				return a->second->_distance_from_camera > b->second->_distance_from_camera;
-			});
-            // - - Draw all transparent objects in sorted order
-            for (auto& transparent_pair : scene_transparent_pairs) {
-                transparent_pair->second->Draw(my_shader);
+            else {
+                // - - Sort all transparent objects by their distance from camera (far to near)
+                scene_transparent_sorted.Sort(camera.position);
+                // - - Draw all transparent objects in sorted order
+                DrawModels(scene_transparent_sorted, uber_shader, false, true);
             }
             glDisable(GL_BLEND);
             glEnable(GL_CULL_FACE);
             glDepthMask(GL_TRUE);
+            transparent_gpu_zone.End();
+            transparent_zone.End();
 
             // === End of frame ===
+            // CPU time measure end, the rest waits for the GPU or V-Sync
+            std::chrono::duration<float, std::milli> cpu_ms = std::chrono::steady_clock::now() - frame_start_timestamp;
+
             // Swap front and back buffers
-            glfwSwapBuffers(window);
+            gpu_profiler.EndFrame();
+            ProfilerZone swap_zone("SwapBuffers");
+            if (headless.is_on) EndHeadlessFrame();
+            else glfwSwapBuffers(window);
+            swap_zone.End();
 
             // Poll for and process events
+            ProfilerZone events_zone("PollEvents");
             glfwPollEvents();
+            events_zone.End();
+
+            PROFILE_COUNTER("Visible models", GetVisibleCount());
+            PROFILE_COUNTER("GPU memory (MB)", residency_manager.GetUsedBytes() / (1024 * 1024));
+            PROFILE_COUNTER("Virtual texture pages", virtual_texture.GetResidentCount());
             
-            // Time/FPS measure end
-            auto fps_frame_end_timestamp = std::chrono::steady_clock::now();
-            std::chrono::duration<double> fps_elapsed_seconds = fps_frame_end_timestamp - fps_frame_start_timestamp;
-            fps_counter_seconds += fps_elapsed_seconds.count();
-            fps_counter_frames++;
-            if (fps_counter_seconds >= 1) {                
-                FPS = fps_counter_frames;
-                fps_counter_seconds = 0;
-                fps_counter_frames = 0;
+            // Frame time measure end (the whole frame interval), GPU time of a frame a few frames back
+            std::chrono::duration<float, std::milli> frame_ms = std::chrono::steady_clock::now() - frame_start_timestamp;
+            frame_stats.AddFrame(current_timestamp, frame_ms.count(), cpu_ms.count());
+            uint64_t gpu_frame;
+            float gpu_ms;
+            if (gpu_profiler.TakeFrameTime(gpu_frame, gpu_ms)) {
+                frame_stats.SetGPUTime(gpu_frame, gpu_ms);
+                stress_report.SetGPUTime(gpu_frame, gpu_ms);
+            }
+            if (stress.is_on) EndStressFrame(current_timestamp, frame_ms.count(), cpu_ms.count());
+
+            // Window title, formatting every frame would cost more than it tells
+            if (frame_stats.IsReportDue(current_timestamp)) {
+                frame_stats.SetReported(current_timestamp);
+                UpdateWindowTitle();
             }
-            // Window title
-            std::stringstream ss;
-            ss << FPS << " FPS | " << FOV << " FOV | X" << camera.position.x << " Y" << camera.position.y << " Z" << camera.position.z;
-            glfwSetWindowTitle(window, ss.str().c_str());
         }
     }
     catch (std::exception const& e) {
         std::cerr << "App failed : " << e.what() << "\n";
         return EXIT_FAILURE;
     }
+
+    input_recorder.Stop();
+
+    // Frame times of the whole run
+    frame_stats.Print();
+    std::filesystem::path stats_path = std::filesystem::path(PROFILER_DIR) / ("frames_" + std::to_string(std::time(nullptr)) + ".csv");
+    if (frame_stats.SaveCSV(stats_path)) std::cout << "Frame times: " << stats_path.string() << "\n";
+    stats_path.replace_extension(".summary.csv");
+    frame_stats.SaveSummaryCSV(stats_path);
     
     PrintGLInfo();
 
@@ -356,7 +493,21 @@ int App::Run(void)
 App::~App()
 {
     // clean-up
-    my_shader.Clear();
+    shader_watcher.Stop();
+    for (auto& [flags, uber_shader] : uber_shaders) {
+        uber_shader.Clear();
+    }
+    depth_shader.Clear();
+    oit.Clear();
+    occlusion_culler.Clear();
+    clustered_lights.Clear();
+    gpu_profiler.Clear();
+    offscreen.Clear();
+    residency_manager.Clear();
+    virtual_texture.Clear();
+    texture_table.Clear();
+    TextureSetStreamer(nullptr);
+    texture_streamer.Clear();
 
     if (window) {
         glfwDestroyWindow(window);
@@ -367,6 +518,46 @@ App::~App()
     std::cout << "Bye...\n";
 }
 
+void App::UpdateShaders()
+{
+    PROFILE_ZONE("App::UpdateShaders");
+    std::vector<ShaderProgram*> shaders = { &depth_shader, &oit.GetCompositeShader() };
+    for (auto& [flags, uber_shader] : uber_shaders) {
+        shaders.push_back(&uber_shader);
+    }
+    if (shader_watcher.HasChanged()) {
+        std::cout << "Shaders changed, reloading\n";
+        for (auto shader : shaders) {
+            shader->Reload(); // Unchanged ones come from the binary cache right away
+        }
+    }
+    for (auto shader : shaders) {
+        shader->Update();
+    }
+}
+
+void App::UpdateWindowTitle()
+{
+    // Fixed buffer, no allocations
+    const FrameStats::Summary& all = frame_stats.GetFrameSummary();
+    char title[512];
+    int n = snprintf(title, sizeof(title), "%.0f FPS | p50 %.1f p99 %.1f 1%% low %.1f ms | %d hitches",
+        frame_stats.GetFPS(), all.p50, all.p99, all.low_1, all.hitches);
+    const FrameStats::Summary& cpu = frame_stats.GetCPUSummary();
+    const FrameStats::Summary& gpu = frame_stats.GetGPUSummary();
+    auto append = [&title, &n](const char* format, auto... args) {
+        if (n >= 0 && n < static_cast<int>(sizeof(title))) n += snprintf(title + n, sizeof(title) - n, format, args...);
+    };
+    append(" | CPU p50 %.1f p99 %.1f ms", cpu.p50, cpu.p99);
+    if (gpu.frames) append(" | GPU p50 %.1f p99 %.1f ms", gpu.p50, gpu.p99);
+    append(" | %.0f FOV | X%.1f Y%.1f Z%.1f", FOV, camera.position.x, camera.position.y, camera.position.z);
+    if (is_frustum_culling_on) append(" | %d visible %d culled", GetVisibleCount(), GetCulledCount());
+    if (is_occlusion_culling_on) append(" | %d occluded", GetOccludedCount());
+    if (is_software_occlusion_on) append(" | %d/%d occluded (CPU)", GetSoftwareOccludedCount(), GetSoftwareTestedCount());
+    if (residency_manager.GetEvictedCount()) append(" | %d MB GPU, %d evicted", static_cast<int>(residency_manager.GetUsedBytes() / (1024 * 1024)), residency_manager.GetEvictedCount());
+    glfwSetWindowTitle(window, title);
+}
+
 void App::UpdateProjectionMatrix(void)
 {
     if (window_height < 1) window_height = 1; // avoid division by 0
@@ -376,8 +567,8 @@ void App::UpdateProjectionMatrix(void)
     mx_projection = glm::perspective(
         glm::radians(FOV),   // The vertical Field of View
         ratio,               // Aspect Ratio. Depends on the size of your window.
-        0.1f,                // Near clipping plane. Keep as big as possible, or you'll get precision issues.
-        20000.0f             // Far clipping plane. Keep as little as possible.
+        CAMERA_NEAR,         // Near clipping plane
+        CAMERA_FAR           // Far clipping plane
     );
 }
 
@@ -1,38 +1,84 @@
 #pragma once
 
 #include <map>
+#include <random>
 
 #include "Model.hpp"
 #include "ShaderProgram.hpp"
 #include "Camera.hpp"
 #include "AudioSlave.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionCuller.hpp"
+#include "SoftwareOcclusionCuller.hpp"
+#include "DepthSortedList.hpp"
+#include "WeightedBlendedOIT.hpp"
+#include "FileWatcher.hpp"
+#include "ClusteredLights.hpp"
+#include "TextureTable.hpp"
+#include "ImageDecoder.hpp"
+#include "ResidencyManager.hpp"
+#include "VirtualTexture.hpp"
+#include "GPUProfiler.hpp"
+#include "FrameStats.hpp"
+#include "InputRecorder.hpp"
+#include "OffscreenTarget.hpp"
+#include "ScalingReport.hpp"
 
 #define PLAYER_HEIGHT 1.0f      // Camera above ground
 #define HEIGHTMAP_SHIFT 50.0f   // Heightmap is shifted by this value on x and z coordinates
 #define N_PROJECTILES 10        // How many projectiles are there in the pool
+#define CAMERA_NEAR 0.1f        // Near clipping plane. Keep as big as possible, or you'll get precision issues.
+#define CAMERA_FAR 20000.0f     // Far clipping plane. Keep as little as possible.
 
 #define HIDE_CUBES_INSTEAD_DESTROY true // If hit by projectile, glass cubes are hidden under ground instead of removed from scene ('R' key does nothing if false)
 #define HIDE_CUBE_Y 10.0f               // Hide cubes by subtracting this from their Y coordinate
 
+#define HEADLESS_FRAMES 600          // Frames rendered in the headless mode, then the app exits
+#define HEADLESS_DUMP_DIR "./frames" // PNG dumps of the headless mode
+
+#define STRESS_INSTANCES 0, 10, 25, 50, 100, 200 // Instances of every stress asset, one measured step each
+#define STRESS_LIGHTS 64                // Moving point lights of the stress mode
+#define STRESS_SHOTS_PER_SECOND 20.0f   // Projectiles fired by the stress mode
+#define STRESS_SHOT_FLIGHT 2.0f         // Seconds of the longest stress shot (10 above ground at projectile_speed), pool gets shots/s * this more
+#define STRESS_STEP_SECONDS 5.0         // Measured time of one step
+#define STRESS_AREA 45.0f               // Instances are spread over x, z in -STRESS_AREA..STRESS_AREA
+#define STRESS_SEED 1                   // Same scene in every run
+
+// Uber shader permutation flags (each one is a #define in uber.frag)
+#define UBER_FLASHLIGHT 1 // FLASHLIGHT
+#define UBER_TEXTURED 2   // TEXTURED
+
 class App {
 public:
     App();
 
+    bool ParseArguments(int argc, char* argv[]); // Before Init(); false = bad arguments, usage was printed
     bool Init();
     void InitAssets();
     int Run(); // Run every frame
     Model* CreateModel(std::string name, std::string obj, std::string tex, bool is_opaque, glm::vec3 position, float scale, glm::vec4 rotation, bool collision, bool use_aabb);
     void UpdateModels(float delta_time); // Inside Run(); time based update of objects in the scene
 
+    // Culling statistics of the last frame
+    int GetVisibleCount() const { return frustum_culler.GetVisibleCount(); }
+    int GetCulledCount() const { return frustum_culler.GetCulledCount(); }
+    int GetOccludedCount() const { return occlusion_culler.GetOccludedCount(); }
+    int GetSoftwareOccludedCount() const { return software_occlusion_culler.GetOccludedCount(); }
+    int GetSoftwareTestedCount() const { return software_occlusion_culler.GetTestedCount(); }
+
     ~App();
 private:
     std::map<std::string, Model*> scene_opaque;
     std::map<std::string, Model*> scene_transparent;
-    std::vector<std::pair<const std::string, Model*>*> scene_transparent_pairs; // Used for sorting transparent scene
+    DepthSortedList scene_opaque_sorted = DepthSortedList(false);     // Opaque scene sorted near to far (less overdraw)
+    DepthSortedList scene_transparent_sorted = DepthSortedList(true); // Used for sorting transparent scene
+    WeightedBlendedOIT oit;                   // Used instead of sorting if is_oit_on
 
     bool is_vsync_on{};
     bool is_fullscreen_on = false;
     bool is_mouselook_on = true;
+    bool is_oit_on = false; // Order-independent transparency instead of sorted transparent objects
+    bool is_depth_prepass_on = true; // Lighting is computed only once for every pixel of opaque objects
     
     GLFWmonitor* monitor{};
     const GLFWvidmode* mode{};
@@ -44,14 +90,48 @@ private:
     int window_height_return_from_fullscreen{};
 
     float FOV = 110.0f;
-    int FPS = 0;
+    FrameStats frame_stats; // Frame/CPU/GPU times of Run(), saved on exit
+
+    // Headless mode (--headless): no window shown, the scene goes to an offscreen framebuffer, fixed number of frames
+    struct HeadlessOptions {
+        bool is_on = false;
+        int context_api = GLFW_NATIVE_CONTEXT_API; // Hidden window of the desktop; GLFW_OSMESA_CONTEXT_API = software (llvmpipe), GLFW_EGL_CONTEXT_API = GPU without a display
+        int frames = HEADLESS_FRAMES;
+        std::vector<int> dump_frames;              // Saved as PNG, counted from 1
+        std::string dump_dir = HEADLESS_DUMP_DIR;
+    } headless;
+    OffscreenTarget offscreen;
+    int headless_frame = 0;
+    void EndHeadlessFrame(); // Inside Run() instead of SwapBuffers; dumps the frame, stops after the last one
+
+    // Stress mode (--stress): generated instances on the heightmap, moving lights and shots, frame time versus scene size
+    struct StressOptions {
+        bool is_on = false;
+        std::vector<int> instances = { STRESS_INSTANCES }; // Per asset, one step each
+        int lights = STRESS_LIGHTS;
+        float shots_per_second = STRESS_SHOTS_PER_SECOND;
+        double step_seconds = STRESS_STEP_SECONDS;
+    } stress;
+    std::vector<Model*> stress_models; // All generated ones, instance-major; the first stress_count are in the scene
+    size_t stress_count = 0;
+    ScalingReport stress_report;
+    std::mt19937 stress_random{ STRESS_SEED };
+    float stress_shots = 0.0f;         // Due shots, one is fired for every whole one
+    int stress_dropped_shots = 0;      // Pool was too small, a flying projectile is never taken away
+    void InitStress();                 // Inside InitAssets(), after the heightmap
+    void SetStressInstances(int n);    // Move instances in or out of the scene
+    void UpdateStress(float delta_time);              // Inside Run(); shots
+    void AddStressLights();                           // Inside Run(), between ClusteredLights::BeginFrame() and Update()
+    void EndStressFrame(double timestamp, float frame_ms, float cpu_ms); // Inside Run(); next step, report and exit after the last one
     glm::mat4 mx_projection = glm::identity<glm::mat4>();
+    glm::mat4 mx_view_projection = glm::identity<glm::mat4>(); // Updated every frame in Run()
     Camera camera = Camera(glm::vec3(0, 0, 0));
 
     GLFWwindow* window = nullptr;
     glm::vec4 clear_color = glm::vec4(243 / 255.0f, 196 / 255.0f, 128 / 255.0f, 0.0f);
 
     void UpdateProjectionMatrix();
+    void UpdateWindowTitle(); // Inside Run(), a few times per second
 
     void PrintGLInfo();
 
@@ -62,7 +142,28 @@ private:
     static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
-    ShaderProgram my_shader;
+    // Callbacks only queue scene input, Run() handles it at the beginning of the next frame
+    InputRecorder input_recorder; // --record FILE, --replay FILE
+    double scene_time = 0.0;      // Sum of frame delta times, animations use it instead of the wall clock
+    void HandleInputEvent(const InputEvent& event);
+    void HandleKey(int key, int action, int mods);
+    void HandleMouseButton(int button, int action);
+    void HandleScroll(double yoffset);
+
+    std::map<int, ShaderProgram> uber_shaders; // Permutations of uber.vert/uber.frag, key = UBER_* flags
+    void CreateUberShader(int flags);
+    ShaderProgram& GetUberShader();            // Permutation for the current state (flashlight on/off)
+    ClusteredLights clustered_lights;          // Point lights: jukebox, projectiles
+    TextureTable texture_table;                // Textures of all models
+    TextureStreamer texture_streamer;          // Fine mip levels of cooked textures, uploaded over the first frames
+    ImageDecoder image_decoder;                // Worker threads decoding images during InitAssets()
+    ResidencyManager residency_manager;        // GPU memory budget, evicts textures and meshes of models long out of view
+    VirtualTexture virtual_texture;            // Heightmap texture, pages streamed from a tiled file
+    bool is_virtual_texture_on = true;
+    GPUProfiler gpu_profiler;                  // GPU time of render passes, read back a few frames later
+    ShaderProgram depth_shader; // Depth pre-pass
+    FileWatcher shader_watcher; // resources/shaders, changed shaders are recompiled in the background
+    void UpdateShaders();       // Inside Run(); start reloads, swap in finished ones
 
     AudioSlave audio;
 
@@ -78,15 +179,27 @@ private:
     std::map<std::pair<float, float>, float>* _heights{};
     float GetHeightmapY(float position_x, float position_z) const;
 
+    // Culling
+    bool is_frustum_culling_on = true;
+    FrustumCuller frustum_culler;
+    void CullScene(const glm::mat4& mx_view_projection); // Inside Run(); set is_visible of all models (and heightmap chunks)
+    bool is_occlusion_culling_on = false;
+    OcclusionCuller occlusion_culler;
+    bool is_software_occlusion_on = false;
+    SoftwareOcclusionCuller software_occlusion_culler; // Rasterized on a worker thread while objects are updated
+    void DrawModels(DepthSortedList& models, ShaderProgram& shader, bool depth_only, bool issue_occlusion_queries); // Draw visible models, skip occluded ones
+    void CullOccludedModels(); // Inside Run(), after CullScene(); hide visible models behind software occluders
+
     // Collision
     std::vector<Model*> collisions; // All objects projectile can collide with
 
     // Projectiles
     const float projectile_speed = 20.0f;
     int projectile_n = 0;                   // Currently used projectile
-    Model* projectiles[N_PROJECTILES]{};    // Pool of projectiles
-    glm::vec3 projectile_directions[N_PROJECTILES]{};
-    bool is_projectile_moving[N_PROJECTILES]{};
+    std::vector<Model*> projectiles;        // Pool of projectiles, N_PROJECTILES (+ stress shots in flight), created by InitAssets()
+    std::vector<glm::vec3> projectile_directions;
+    std::vector<bool> is_projectile_moving;
     void Shoot();
+    void ShootFrom(glm::vec3 position, glm::vec3 direction); // Oldest projectile of the pool is reused
     void UpdateProjectiles(float delta_time);
 };
\ No newline at end of file
@@ -1,6 +1,16 @@
 #include <iostream>
 
 #include "App.hpp"
+#include "Profiler.hpp"
+
+void App::HandleInputEvent(const InputEvent& event)
+{
+    switch (event.type) {
+    case InputEvent::KEY: HandleKey(event.code, event.action, event.mods); break;
+    case InputEvent::MOUSE_BUTTON: HandleMouseButton(event.code, event.action); break;
+    case InputEvent::SCROLL: HandleScroll(event.offset); break;
+    }
+}
 
 void App::error_callback(int error, const char* description)
 {
@@ -11,11 +21,12 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
 {
     auto this_inst = static_cast<App*>(glfwGetWindowUserPointer(window));
     if ((action == GLFW_PRESS) || (action == GLFW_REPEAT)) {
+        // Window and tools, right away and never recorded
         switch (key) {
         case GLFW_KEY_ESCAPE:
             // Exit The App
             glfwSetWindowShouldClose(window, GLFW_TRUE);
-            break;
+            return;
 
         case GLFW_KEY_F11:
             // Fullscreen on/off
@@ -29,24 +40,88 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
             else { // Set windowed with remembered window info
                 glfwSetWindowMonitor(window, nullptr, this_inst->window_xcor, this_inst->window_ycor, this_inst->window_width_return_from_fullscreen, this_inst->window_height_return_from_fullscreen, 0);
             }
-            break;
+            return;
 
         case GLFW_KEY_V:
-            // Vsync on/off
+            // Vsync on/off, stays off during a stress run
+            if (this_inst->stress.is_on) {
+                std::cout << "VSync: off in stress mode\n";
+                return;
+            }
             this_inst->is_vsync_on = !this_inst->is_vsync_on;
             glfwSwapInterval(this_inst->is_vsync_on);
             std::cout << "VSync: " << this_inst->is_vsync_on << "\n";
-            break;
+            return;
 
+        case GLFW_KEY_F9:
+            // Save the last ~30 s of CPU and GPU zones, open in chrome://tracing or https://ui.perfetto.dev
+            // GPU times per pass also go to a CSV next to it
+            if (action == GLFW_PRESS) {
+                auto path = Profiler::Save();
+                if (path.empty()) return;
+                std::cout << "Profile: " << path.string() << "\n";
+                auto csv_path = path;
+                csv_path.replace_extension(".gpu.csv");
+                if (this_inst->gpu_profiler.SaveCSV(csv_path)) std::cout << "GPU times: " << csv_path.string() << "\n";
+            }
+            return;
+        }
+    }
+
+    // Scene, at the beginning of the next frame (ignored while replaying)
+    this_inst->input_recorder.AddEvent({ InputEvent::KEY, key, action, mods, 0.0 });
+}
+
+void App::HandleKey(int key, int action, int mods)
+{
+    if ((action == GLFW_PRESS) || (action == GLFW_REPEAT)) {
+        switch (key) {
         case GLFW_KEY_F:
             // Flashlight on/off
-            this_inst->is_flashlight_on = (this_inst->is_flashlight_on + 1) % 2;
+            is_flashlight_on = (is_flashlight_on + 1) % 2;
+            break;
+
+        case GLFW_KEY_C:
+            // Frustum culling on/off
+            is_frustum_culling_on = !is_frustum_culling_on;
+            std::cout << "Frustum culling: " << is_frustum_culling_on << "\n";
+            break;
+
+        case GLFW_KEY_H:
+            // Hardware occlusion culling on/off
+            is_occlusion_culling_on = !is_occlusion_culling_on;
+            std::cout << "Occlusion culling: " << is_occlusion_culling_on << "\n";
+            break;
+
+        case GLFW_KEY_M:
+            // Software (CPU) occlusion culling on/off
+            is_software_occlusion_on = !is_software_occlusion_on;
+            std::cout << "Software occlusion culling: " << is_software_occlusion_on << "\n";
+            break;
+
+        case GLFW_KEY_O:
+            // Order-independent transparency on/off
+            is_oit_on = !is_oit_on;
+            std::cout << "OIT: " << is_oit_on << "\n";
+            break;
+
+        case GLFW_KEY_P:
+            // Depth pre-pass on/off
+            is_depth_prepass_on = !is_depth_prepass_on;
+            std::cout << "Depth pre-pass: " << is_depth_prepass_on << "\n";
+            break;
+
+        case GLFW_KEY_T:
+            // Virtual texture of the terrain on/off (tilemap otherwise)
+            is_virtual_texture_on = !is_virtual_texture_on;
+            virtual_texture.SetEnabled(is_virtual_texture_on);
+            std::cout << "Virtual texture: " << is_virtual_texture_on << "\n";
             break;
 
         case GLFW_KEY_R:
             // Reset glass cubes
             if (HIDE_CUBES_INSTEAD_DESTROY) {
-                for (const auto& pair : this_inst->scene_transparent) {
+                for (const auto& pair : scene_transparent) {
                     if (pair.first.substr(0, 15) == "obj_glass_cube_" && pair.second->position.y < 0.0f) {
                         pair.second->position.y += HIDE_CUBE_Y; // Move them up if they're under ground
                     }
@@ -58,16 +133,21 @@ void App::key_callback(GLFWwindow* window, int key, int scancode, int action, in
     
     // Minecraft-like sprint
     if (action == GLFW_PRESS && (key == GLFW_KEY_LEFT_CONTROL || key == GLFW_KEY_RIGHT_CONTROL)) {
-        this_inst->camera.ToggleSprint();
+        camera.ToggleSprint();
     }
 }
 
 void App::scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    auto this_inst = static_cast<App*>(glfwGetWindowUserPointer(window));    
-    this_inst->FOV -= 10.0f * static_cast<float>(yoffset);      // Scrollwheel down == FOV++
-    this_inst->FOV = std::clamp(this_inst->FOV, 70.0f, 160.0f); // Limit FOV to "reasonable" values
-    this_inst->UpdateProjectionMatrix();
+    auto this_inst = static_cast<App*>(glfwGetWindowUserPointer(window));
+    this_inst->input_recorder.AddEvent({ InputEvent::SCROLL, 0, 0, 0, yoffset });
+}
+
+void App::HandleScroll(double yoffset)
+{
+    FOV -= 10.0f * static_cast<float>(yoffset); // Scrollwheel down == FOV++
+    FOV = std::clamp(FOV, 70.0f, 160.0f);       // Limit FOV to "reasonable" values
+    UpdateProjectionMatrix();
 }
 
 void App::framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -77,6 +157,7 @@ void App::framebuffer_size_callback(GLFWwindow* window, int width, int height)
     this_inst->window_height = height;
     // set viewport
     glViewport(0, 0, width, height);
+    this_inst->oit.Resize(width, height);
     // now your canvas has [0,0] in bottom left corner, and its size is [width x height] 
     this_inst->UpdateProjectionMatrix();
 }
@@ -84,21 +165,26 @@ void App::framebuffer_size_callback(GLFWwindow* window, int width, int height)
 void App::mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
     auto this_inst = static_cast<App*>(glfwGetWindowUserPointer(window));
+    this_inst->input_recorder.AddEvent({ InputEvent::MOUSE_BUTTON, button, action, mods, 0.0 });
+}
+
+void App::HandleMouseButton(int button, int action)
+{
     // LMB to shoot
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-        if (this_inst->is_mouselook_on) {
-            this_inst->Shoot();
-            this_inst->audio.Play2DOneShot("snd_shoot");
+        if (is_mouselook_on) {
+            Shoot();
+            audio.Play2DOneShot("snd_shoot");
         }
         else {
-            this_inst->is_mouselook_on = true;
+            is_mouselook_on = true;
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         }
     }
     // RMB to toggle mouselook
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
-        this_inst->is_mouselook_on = !this_inst->is_mouselook_on;
-        if (this_inst->is_mouselook_on) {
+        is_mouselook_on = !is_mouselook_on;
+        if (is_mouselook_on) {
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         }
         else {
@@ -0,0 +1,122 @@
+#include "App.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void App::CullScene(const glm::mat4& mx_view_projection)
+{
+	PROFILE_ZONE("App::CullScene");
+	// World space bounding spheres are also used for sorting
+	for (auto scene : { &scene_opaque, &scene_transparent }) {
+		for (auto& [key, model] : *scene) {
+			model->world_bounds = model->GetWorldBoundingSphere(model->GetModelMatrix(), model->bounds);
+		}
+	}
+
+	// Culling disabled  everything is visible
+	if (!is_frustum_culling_on) {
+		for (auto scene : { &scene_opaque, &scene_transparent }) {
+			for (auto& [key, model] : *scene) {
+				model->is_visible = true;
+				for (auto& chunk : model->chunks) {
+					chunk.is_visible = true;
+				}
+			}
+		}
+		return;
+	}
+
+	// Gather world space bounding spheres of all models (heightmap is split into chunks)
+	frustum_culler.SetFrustum(mx_view_projection);
+	frustum_culler.Clear();
+	for (auto scene : { &scene_opaque, &scene_transparent }) {
+		for (auto& [key, model] : *scene) {
+			const auto& mx_model = model->GetModelMatrix();
+			if (model->chunks.empty()) {
+				frustum_culler.AddSphere(model->world_bounds);
+			}
+			else {
+				for (const auto& chunk : model->chunks) {
+					frustum_culler.AddSphere(model->GetWorldBoundingSphere(mx_model, chunk.bounds));
+				}
+			}
+		}
+	}
+
+	// Test them all at once
+	frustum_culler.Cull();
+
+	// Read the results in the same order
+	size_t i = 0;
+	for (auto scene : { &scene_opaque, &scene_transparent }) {
+		for (auto& [key, model] : *scene) {
+			if (model->chunks.empty()) {
+				model->is_visible = frustum_culler.IsVisible(i++);
+			}
+			else {
+				model->is_visible = false;
+				for (auto& chunk : model->chunks) {
+					chunk.is_visible = frustum_culler.IsVisible(i++);
+					model->is_visible |= chunk.is_visible;
+				}
+			}
+		}
+	}
+	print("CullScene: visible " << frustum_culler.GetVisibleCount() << ", culled " << frustum_culler.GetCulledCount());
+}
+
+void App::CullOccludedModels()
+{
+	PROFILE_ZONE("App::CullOccludedModels");
+	// Occluders were rasterized while the scene was updated
+	software_occlusion_culler.EndRasterize();
+
+	for (auto scene : { &scene_opaque, &scene_transparent }) {
+		for (auto& [key, model] : *scene) {
+			if (model->is_visible && model->chunks.empty() && software_occlusion_culler.IsOccluded(model->world_bounds)) {
+				model->is_visible = false;
+			}
+		}
+	}
+	print("CullOccludedModels: occluded " << software_occlusion_culler.GetOccludedCount() << " of " << software_occlusion_culler.GetTestedCount());
+}
+
+void App::DrawModels(DepthSortedList& models, ShaderProgram& shader, bool depth_only, bool issue_occlusion_queries)
+{
+	if (!is_occlusion_culling_on) {
+		for (size_t i = 0; i < models.Size(); i++) {
+			if (!models[i]->is_visible) continue;
+			if (models[i]->chunks.empty()) {
+				models[i]->Draw(shader, depth_only);
+				continue;
+			}
+			GPUProfilerZone terrain_gpu_zone(gpu_profiler, "Terrain");
+			models[i]->Draw(shader, depth_only);
+		}
+		return;
+	}
+
+	// Occluders first (heightmap is split into chunks)
+	for (size_t i = 0; i < models.Size(); i++) {
+		if (models[i]->is_visible && !models[i]->chunks.empty()) {
+			GPUProfilerZone terrain_gpu_zone(gpu_profiler, "Terrain");
+			models[i]->Draw(shader, depth_only);
+		}
+	}
+
+	// Test bounding boxes of the rest against them
+	if (issue_occlusion_queries) {
+		GPUProfilerZone queries_gpu_zone(gpu_profiler, "Occlusion queries");
+		occlusion_culler.BeginQueries(depth_shader, mx_view_projection, camera.position);
+		for (size_t i = 0; i < models.Size(); i++) {
+			if (models[i]->is_visible && models[i]->chunks.empty()) occlusion_culler.Query(models[i]);
+		}
+		occlusion_culler.EndQueries();
+		shader.Activate();
+	}
+
+	// Draw the rest only if their bounding boxes passed
+	for (size_t i = 0; i < models.Size(); i++) {
+		if (models[i]->is_visible && models[i]->chunks.empty()) occlusion_culler.Draw(models[i], shader, depth_only);
+	}
+}
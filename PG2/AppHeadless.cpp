@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "App.hpp"
+#include "LeanImageBackend.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+bool App::ParseArguments(int argc, char* argv[])
+{
+    auto usage = [argv]() {
+        std::cerr << "Usage: " << argv[0] << " [--headless] [--size WIDTHxHEIGHT] [--frames N] [--dump N,N,...] [--dump-dir DIR] [--context native|osmesa|egl] [--record FILE | --replay FILE]\n"
+            << "       [--stress] [--stress-instances N,N,...] [--stress-lights M] [--stress-shots K] [--stress-step SECONDS]\n"
+            << "  --headless  no window, render offscreen and exit after --frames frames (default " << HEADLESS_FRAMES << ")\n"
+            << "  --dump      save these frames (counted from 1) as PNG into --dump-dir (default " << HEADLESS_DUMP_DIR << ")\n"
+            << "  --context   native = hidden window of the desktop (default), osmesa = software rendering (llvmpipe), egl = GPU without a display\n"
+            << "  --record    save keys, mouse and frame delta times of the run\n"
+            << "  --replay    run a recording again with its delta times, exits at its end\n"
+            << "  --stress    N generated instances of every asset in each step, M moving lights (default " << STRESS_LIGHTS << "),\n"
+            << "              K shots per second (default " << STRESS_SHOTS_PER_SECOND << "); every step is measured for SECONDS (default " << STRESS_STEP_SECONDS << "),\n"
+            << "              then the frame time versus N goes to the console and " PROFILER_DIR "/stress_*.csv\n";
+        return false;
+    };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless") {
+            headless.is_on = true;
+        }
+        else if (arg == "--size" && has_value) {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string::npos) return usage();
+            window_width = std::atoi(size.substr(0, x).c_str());
+            window_height = std::atoi(size.substr(x + 1).c_str());
+            if (window_width < 1 || window_height < 1) return usage();
+        }
+        else if (arg == "--frames" && has_value) {
+            headless.frames = std::atoi(argv[++i]);
+            if (headless.frames < 1) return usage();
+        }
+        else if (arg == "--dump" && has_value) {
+            std::stringstream list(argv[++i]);
+            std::string frame;
+            while (std::getline(list, frame, ',')) headless.dump_frames.push_back(std::atoi(frame.c_str()));
+        }
+        else if (arg == "--dump-dir" && has_value) {
+            headless.dump_dir = argv[++i];
+        }
+        else if (arg == "--context" && has_value) {
+            std::string api = argv[++i];
+            if (api == "native") headless.context_api = GLFW_NATIVE_CONTEXT_API;
+            else if (api == "osmesa") headless.context_api = GLFW_OSMESA_CONTEXT_API;
+            else if (api == "egl") headless.context_api = GLFW_EGL_CONTEXT_API;
+            else return usage();
+        }
+        else if (arg == "--stress") {
+            stress.is_on = true;
+        }
+        else if (arg == "--stress-instances" && has_value) {
+            stress.is_on = true;
+            stress.instances.clear();
+            std::stringstream list(argv[++i]);
+            std::string n;
+            while (std::getline(list, n, ',')) stress.instances.push_back(std::atoi(n.c_str()));
+            if (stress.instances.empty() || *std::min_element(stress.instances.begin(), stress.instances.end()) < 0) return usage();
+        }
+        else if (arg == "--stress-lights" && has_value) {
+            stress.is_on = true;
+            stress.lights = std::atoi(argv[++i]);
+            if (stress.lights < 0) return usage();
+        }
+        else if (arg == "--stress-shots" && has_value) {
+            stress.is_on = true;
+            stress.shots_per_second = static_cast<float>(std::atof(argv[++i]));
+            if (stress.shots_per_second < 0.0f) return usage();
+        }
+        else if (arg == "--stress-step" && has_value) {
+            stress.is_on = true;
+            stress.step_seconds = std::atof(argv[++i]);
+            if (stress.step_seconds <= 0.0) return usage();
+        }
+        else if (arg == "--record" && has_value && !input_recorder.IsReplaying()) {
+            if (!input_recorder.StartRecording(argv[++i])) return false;
+        }
+        else if (arg == "--replay" && has_value && !input_recorder.IsRecording()) {
+            if (!input_recorder.StartReplay(argv[++i])) return false;
+        }
+        else {
+            return usage();
+        }
+    }
+    if (headless.is_on) {
+        std::cout << "Headless: " << window_width << "x" << window_height << ", " << headless.frames << " frames\n";
+    }
+    return true;
+}
+
+void App::EndHeadlessFrame()
+{
+    headless_frame++;
+    if (std::find(headless.dump_frames.begin(), headless.dump_frames.end(), headless_frame) != headless.dump_frames.end()) {
+        PROFILE_ZONE("Frame dump");
+        std::string name = std::to_string(headless_frame);
+        std::filesystem::path path = std::filesystem::path(headless.dump_dir) / ("frame_" + std::string(name.size() < 5 ? 5 - name.size() : 0, '0') + name + ".png");
+        std::vector<unsigned char> png = LeanImageBackend::EncodePNG(offscreen.Read());
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+        if (file.good()) std::cout << "Headless: frame " << headless_frame << " -> " << path.string() << "\n";
+        else std::cerr << "Headless: Can not write " << path << "\n";
+    }
+    else {
+        glFlush(); // Nothing waits for the GPU like SwapBuffers would
+    }
+    if (headless_frame >= headless.frames && !stress.is_on) glfwSetWindowShouldClose(window, GLFW_TRUE); // Stress mode ends after its last step
+}
@@ -1,6 +1,6 @@
-#include <opencv2/opencv.hpp>
-
 #include "App.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
 
 #define print(x) std::cout << x << "\n"
 
@@ -11,7 +11,7 @@
 
 Model* App::CreateModel(std::string name, std::string obj, std::string tex, bool is_opaque, glm::vec3 position, float scale, glm::vec4 rotation, bool collision, bool use_aabb)
 {	
-	if (name.substr(0, 15) != "obj_projectile_") print("Loading " << name << ":"); // Print object name we're currently loading except projectiles
+	if (name.substr(0, 15) != "obj_projectile_" && name.substr(0, 11) != "obj_stress_") print("Loading " << name << ":"); // Print object name we're currently loading except projectiles and stress instances
 
 	std::filesystem::path modelpath("./resources/objects/" + obj);
 	std::filesystem::path texturepath("./resources/textures/" + tex);
@@ -34,12 +34,23 @@ Model* App::CreateModel(std::string name, std::string obj, std::string tex, bool
 // Load models, load textures, load shaders, initialize level, etc.
 void App::InitAssets()
 {
+	PROFILE_ZONE("App::InitAssets");
 	print("RAM OK\nROM OK");
 	// == SHADERS ==
 	// Load shaders and create ShaderProgram
-	std::filesystem::path VS_path("./resources/shaders/uber.vert");
-	std::filesystem::path FS_path("./resources/shaders/uber.frag");
-	my_shader = ShaderProgram(VS_path, FS_path);
+	// - all models are textured, flashlight can be switched on/off -> 2 permutations, compiled in parallel
+	CreateUberShader(UBER_TEXTURED);
+	CreateUberShader(UBER_TEXTURED | UBER_FLASHLIGHT);
+	std::filesystem::path depth_VS_path("./resources/shaders/depth.vert");
+	std::filesystem::path depth_FS_path("./resources/shaders/depth.frag");
+	depth_shader = ShaderProgram(depth_VS_path, depth_FS_path);
+
+	// == IMAGES ==
+	// Decode (and cook) all at once on decoder threads, models below only wait for theirs
+	for (auto tex : { "jukebox.jpg", "table.png", "Red.png", "Green.png", "Blue.png", "tex_256.png" }) {
+		TexturePrefetch(std::filesystem::path("./resources/textures/") / tex);
+	}
+	ImagePrefetch("./resources/textures/heights.png", IMAGE_CHANNELS_GRAY);
 
 	// == MODELS ==
 	glm::vec3 position{};
@@ -61,16 +72,19 @@ void App::InitAssets()
 	position = glm::vec3(1.0f, 0.0f, 6.0f);
 	scale = 0.015f;
 	rotation = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
-	CreateModel("obj_table", "table.obj", "table.png", true, position, scale, rotation, true, true);
+	software_occlusion_culler.AddOccluder(CreateModel("obj_table", "table.obj", "table.png", true, position, scale, rotation, true, true));
 	// Projectiles
 	print("Loading projectiles:");
 	position = glm::vec3(0.0f, -10.0f, 0.0f); // Hidden
 	scale = 0.05f;
 	rotation = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
-	for (int i = 0; i < N_PROJECTILES; i++) {
+	int n_projectiles = N_PROJECTILES + (stress.is_on ? static_cast<int>(std::ceil(stress.shots_per_second * STRESS_SHOT_FLIGHT)) : 0); // Stress shots in flight
+	projectile_directions.resize(n_projectiles);
+	is_projectile_moving.resize(n_projectiles);
+	for (int i = 0; i < n_projectiles; i++) {
 		auto name = "obj_projectile_" + std::to_string(i);
 		auto obj_projectile_x = CreateModel(name, "sphere_tri_vnt.obj", "Red.png", true, position, scale, rotation, false, false);
-		projectiles[i] = obj_projectile_x;
+		projectiles.push_back(obj_projectile_x);
 	}
 	// Testing AABB spheres (visualize AABB collider around object (table))
 	if (DEBUG_BOUNDINGS) {
@@ -107,26 +121,54 @@ void App::InitAssets()
 	auto obj_heightmap = new Model("heightmap", heightspath, texturepath, position, scale, rotation, true, false);
 	scene_opaque.insert({ "obj_heightmap", obj_heightmap });
 	_heights = &obj_heightmap->_heights;
+	software_occlusion_culler.AddOccluder(obj_heightmap);
+
+	// == STRESS :: generated instances on the heightmap ==
+	if (stress.is_on) InitStress();
 
-	// == for TRANSPARENT OBJECTS sorting ==	
-	for (auto i = scene_transparent.begin(); i != scene_transparent.end(); i++) {
-		scene_transparent_pairs.push_back(&*i); // Add pairs to vector because map cannot be sorted
+	// == for OPAQUE and TRANSPARENT OBJECTS sorting ==
+	for (auto& [key, model] : scene_opaque) {
+		scene_opaque_sorted.Add(model);
 	}
+	for (auto& [key, model] : scene_transparent) {
+		scene_transparent_sorted.Add(model); // Map cannot be sorted
+	}
+
+	// == TEXTURES :: all in one table, draws don't bind them ==
+	std::vector<Model*> models;
+	std::vector<Mesh*> meshes;
+	for (auto scene : { &scene_opaque, &scene_transparent }) {
+		for (auto& [key, model] : *scene) {
+			models.push_back(model);
+			meshes.push_back(&model->GetMesh());
+		}
+	}
+	texture_table.Build(meshes, texture_streamer);
+
+	// == TERRAIN :: one unique virtual texture instead of the tilemap (if supported) ==
+	virtual_texture.Init(obj_heightmap, heightspath, texturepath);
+
+	// == GPU MEMORY :: textures and meshes within a budget ==
+	residency_manager.Init(models, texture_table);
+
+	// == STRESS :: only the instances of the first step stay in the scene ==
+	if (stress.is_on) SetStressInstances(stress_report.GetInstances());
 }
 
 void App::UpdateModels(float delta_time)
 {
+	PROFILE_ZONE("App::UpdateModels");
 	glm::vec3 position{};
 	float scale{};
 	glm::vec4 rotation{};
 
 	// GLASS CUBES rotation
 	auto cube_pair = scene_transparent.find("obj_glass_cube_r");
-	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 23 * glfwGetTime());
+	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 23 * scene_time);
 	cube_pair = scene_transparent.find("obj_glass_cube_g");
-	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 45 * glfwGetTime());
+	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 45 * scene_time);
 	cube_pair = scene_transparent.find("obj_glass_cube_b");
-	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 90 * glfwGetTime());
+	if (cube_pair != scene_transparent.end()) cube_pair->second->rotation = glm::vec4(0.0f, 1.0f, 0.0f, 90 * scene_time);
 
 	// JUKEBOX
 	// - rotate towards player
@@ -152,3 +194,32 @@ void App::UpdateModels(float delta_time)
 		scene_transparent.find("obj_sphere")->second->scale = scale;
 	}
 }
+
+void App::CreateUberShader(int flags)
+{
+	std::vector<std::string> defines;
+	defines.push_back("CLUSTERS_X " + std::to_string(CLUSTERS_X));
+	defines.push_back("CLUSTERS_Y " + std::to_string(CLUSTERS_Y));
+	defines.push_back("CLUSTERS_Z " + std::to_string(CLUSTERS_Z));
+	if (flags & UBER_FLASHLIGHT) defines.push_back("FLASHLIGHT");
+	if (flags & UBER_TEXTURED) defines.push_back("TEXTURED");
+	defines.push_back("VIRTUAL_TEXTURE_INDEX " + std::to_string(VIRTUAL_TEXTURE_INDEX));
+	defines.push_back("VIRTUAL_TEXTURE_UNIT " + std::to_string(VIRTUAL_TEXTURE_UNIT));
+	defines.push_back("VIRTUAL_TEXTURE_PAGE_SIZE " + std::to_string(VIRTUAL_TEXTURE_PAGE_SIZE));
+	defines.push_back("VIRTUAL_TEXTURE_BORDER " + std::to_string(VIRTUAL_TEXTURE_BORDER));
+	defines.push_back("VIRTUAL_TEXTURE_CACHE_PAGES " + std::to_string(VIRTUAL_TEXTURE_CACHE_PAGES));
+	if (GLEW_ARB_bindless_texture) defines.push_back("BINDLESS"); // Same condition as in TextureTable::Build()
+	else defines.push_back("TEXTURE_TABLE_MAX_ARRAYS " + std::to_string(TEXTURE_TABLE_MAX_ARRAYS));
+
+	std::filesystem::path VS_path("./resources/shaders/uber.vert");
+	std::filesystem::path FS_path("./resources/shaders/uber.frag");
+	uber_shaders[flags] = ShaderProgram(VS_path, FS_path, defines);
+}
+
+ShaderProgram& App::GetUberShader()
+{
+	int flags = UBER_TEXTURED;
+	if (is_flashlight_on) flags |= UBER_FLASHLIGHT;
+	if (!uber_shaders.count(flags)) CreateUberShader(flags); // Not expected, all reachable ones are created in InitAssets()
+	return uber_shaders[flags];
+}
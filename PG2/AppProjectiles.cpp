@@ -2,24 +2,31 @@
 #include <string>
 
 #include "App.hpp"
+#include "Profiler.hpp"
 
 #define print(x) //std::cout << x << "\n"
 
 void App::Shoot()
+{
+	ShootFrom(camera.position, camera.front);						// Projectile direction == camera's look direction
+}
+
+void App::ShootFrom(glm::vec3 position, glm::vec3 direction)
 {
 	auto name = "obj_projectile_" + std::to_string(projectile_n);	// Name of currently used projectile
 
-	scene_opaque.find(name)->second->position = camera.position;	// Teleport it to camera's position
+	scene_opaque.find(name)->second->position = position;			// Teleport it to the start
 
-	projectile_directions[projectile_n] = camera.front;				// Projectile direction == camera's look direction
+	projectile_directions[projectile_n] = direction;
 	is_projectile_moving[projectile_n] = true;						// Projectile is marked as moving (not idle)
 
-	projectile_n = (projectile_n + 1) % N_PROJECTILES;				// Switch to next projectile
+	projectile_n = (projectile_n + 1) % static_cast<int>(projectiles.size());	// Switch to next projectile
 }
 
 void App::UpdateProjectiles(float delta_time)
 {
-	for (int i = 0; i < N_PROJECTILES; i++) { // Every frame
+	PROFILE_ZONE("App::UpdateProjectiles");
+	for (size_t i = 0; i < projectiles.size(); i++) { // Every frame
 		if (is_projectile_moving[i]) {		  // for every projectile that's not idle
 			auto name = "obj_projectile_" + std::to_string(i);
 			auto projectile = scene_opaque.find(name)->second;
@@ -45,11 +52,8 @@ void App::UpdateProjectiles(float delta_time)
 							collisions.erase(std::remove(collisions.begin(), collisions.end(), model), collisions.end());
 							// Remove cube from the scene
 							scene_transparent.erase(hit_name);
-							// Remove cube from helper vector for sorting transparent objects (by clearing the whole thing and regenerating it)
-							scene_transparent_pairs.clear();
-							for (auto i = scene_transparent.begin(); i != scene_transparent.end(); i++) {
-								scene_transparent_pairs.push_back(&*i);
-							}
+							// Remove cube from helper list for sorting transparent objects
+							scene_transparent_sorted.Remove(model);
 							// Cleanup
 							model->Clear();
 						}
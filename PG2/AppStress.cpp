@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "App.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+// Generated for every instance, each one is a separate model like the hand-placed ones
+struct StressAsset {
+    const char* name;
+    const char* obj;
+    const char* tex;
+    bool is_opaque;
+    float scale;
+    float y; // Above the ground
+    bool use_aabb;
+};
+static const StressAsset stress_assets[] = {
+    { "table", "table.obj", "table.png", true, 0.015f, 0.0f, true },
+    { "sphere", "sphere_tri_vnt.obj", "Green.png", true, 0.2f, 0.2f, false },
+    { "cube", "cube_triangles_normals_tex.obj", "Blue.png", false, 0.5f, 0.5f, false },
+};
+static const size_t n_stress_assets = std::size(stress_assets);
+
+void App::InitStress()
+{
+    PROFILE_ZONE("App::InitStress");
+    stress_report.Init(stress.instances, stress.step_seconds, stress.lights, stress.shots_per_second);
+
+    int n = *std::max_element(stress.instances.begin(), stress.instances.end());
+    std::cout << "Stress: generating " << n << " instances of " << n_stress_assets << " assets\n";
+    std::uniform_real_distribution<float> area(-STRESS_AREA, STRESS_AREA);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    for (int i = 0; i < n; i++) {
+        for (const auto& asset : stress_assets) {
+            float x = area(stress_random);
+            float z = area(stress_random);
+            glm::vec3 position(x, GetHeightmapY(x, z) + asset.y, z);
+            glm::vec4 rotation(0.0f, 1.0f, 0.0f, angle(stress_random));
+            auto name = std::string("obj_stress_") + asset.name + "_" + std::to_string(i);
+            stress_models.push_back(CreateModel(name, asset.obj, asset.tex, asset.is_opaque, position, asset.scale, rotation, true, asset.use_aabb));
+        }
+    }
+    stress_count = stress_models.size(); // All in the scene until InitAssets() is done, so textures and residency know them
+}
+
+void App::SetStressInstances(int n)
+{
+    size_t count = std::min(static_cast<size_t>(n) * n_stress_assets, stress_models.size());
+    // - into the scene
+    for (; stress_count < count; stress_count++) {
+        Model* model = stress_models[stress_count];
+        bool is_opaque = stress_assets[stress_count % n_stress_assets].is_opaque;
+        (is_opaque ? scene_opaque : scene_transparent).insert({ model->name, model });
+        (is_opaque ? scene_opaque_sorted : scene_transparent_sorted).Add(model);
+        collisions.push_back(model);
+    }
+    // - out of the scene, kept for the next steps
+    for (; stress_count > count; stress_count--) {
+        Model* model = stress_models[stress_count - 1];
+        bool is_opaque = stress_assets[(stress_count - 1) % n_stress_assets].is_opaque;
+        (is_opaque ? scene_opaque : scene_transparent).erase(model->name);
+        (is_opaque ? scene_opaque_sorted : scene_transparent_sorted).Remove(model);
+        collisions.erase(std::remove(collisions.begin(), collisions.end(), model), collisions.end());
+    }
+    print("Stress: " << n << " instances, " << stress_count << " models");
+}
+
+void App::UpdateStress(float delta_time)
+{
+    // Shots from above random places, slightly off vertical
+    std::uniform_real_distribution<float> area(-STRESS_AREA, STRESS_AREA);
+    std::uniform_real_distribution<float> spread(-0.5f, 0.5f);
+    for (stress_shots += stress.shots_per_second * delta_time; stress_shots >= 1.0f; stress_shots -= 1.0f) {
+        float x = area(stress_random);
+        float z = area(stress_random);
+        float dx = spread(stress_random);
+        float dz = spread(stress_random);
+        if (is_projectile_moving[projectile_n]) { // Oldest one still flies: pool too small for this rate
+            stress_dropped_shots++;
+            continue;
+        }
+        ShootFrom(glm::vec3(x, GetHeightmapY(x, z) + 10.0f, z), glm::normalize(glm::vec3(dx, -1.0f, dz)));
+    }
+}
+
+void App::AddStressLights()
+{
+    // Circles around the center, each light with its own radius and color, neighbours go the opposite way
+    for (int i = 0; i < stress.lights; i++) {
+        float phase = i * 2.39996f; // Golden angle
+        float radius = STRESS_AREA * (i + 1) / stress.lights;
+        float angle = phase + static_cast<float>(scene_time) * (i % 2 ? 0.5f : -0.5f);
+        ClusteredLights::PointLight light;
+        light.position = glm::vec3(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+        light.position.y = GetHeightmapY(light.position.x, light.position.z) + 1.5f;
+        light.diffuse = 0.5f + 0.5f * glm::cos(glm::vec3(phase, phase + 2.094f, phase + 4.189f));
+        light.specular = glm::vec3(0.2f);
+        light.constant = 1.0f;
+        light.linear = 0.7f;
+        light.exponent = 1.8f;
+        clustered_lights.AddLight(light);
+    }
+}
+
+void App::EndStressFrame(double timestamp, float frame_ms, float cpu_ms)
+{
+    int models = static_cast<int>(scene_opaque.size() + scene_transparent.size());
+    if (!stress_report.AddFrame(timestamp, frame_ms, cpu_ms, models, GetVisibleCount())) return;
+    if (!stress_report.IsDone()) {
+        SetStressInstances(stress_report.GetInstances());
+        return;
+    }
+
+    // Last step measured
+    stress_report.Print();
+    if (stress_dropped_shots) {
+        std::cout << "Stress: " << stress_dropped_shots << " shots dropped, " << projectiles.size() << " projectiles were not enough (STRESS_SHOT_FLIGHT)\n";
+    }
+    std::filesystem::path path = std::filesystem::path(PROFILER_DIR) / ("stress_" + std::to_string(std::time(nullptr)) + ".csv");
+    if (stress_report.SaveCSV(path)) std::cout << "Scaling report: " << path.string() << "\n";
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
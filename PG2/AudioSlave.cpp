@@ -9,7 +9,8 @@ AudioSlave::AudioSlave()
 {
 	engine = irrklang::createIrrKlangDevice();
 	if (!engine) {
-		std::cerr << "[!] IrrKlang device creation FAILED.\n";
+		std::cerr << "[!] IrrKlang device creation FAILED, no sound.\n";
+		engine = irrklang::createIrrKlangDevice(irrklang::ESOD_NULL); // Silent driver, e.g. build servers without a sound card
 	}
 
 	// Init SFXs
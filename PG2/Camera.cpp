@@ -20,7 +20,7 @@ glm::mat4 Camera::GetViewMatrix()
     return glm::lookAt(this->position, this->position + this->front, this->up);
 }
 
-glm::vec3 Camera::ProcessInput(GLFWwindow* window, GLfloat delta_time)
+glm::vec3 Camera::ProcessInput(const InputFrame& input)
 {
     glm::vec3 direction(0, 0, 0);
     glm::vec3 zero(0, 0, 0);
@@ -28,23 +28,23 @@ glm::vec3 Camera::ProcessInput(GLFWwindow* window, GLfloat delta_time)
     glm::vec3 horizont_front(front.x, 0, front.z);
     glm::vec3 horizont_right(right.x, 0, right.z);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+    if (input.IsHeld(GLFW_KEY_W)) {
         direction += horizont_front;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+    if (input.IsHeld(GLFW_KEY_S)) {
         direction += -horizont_front;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+    if (input.IsHeld(GLFW_KEY_A)) {
         direction += -horizont_right;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+    if (input.IsHeld(GLFW_KEY_D)) {
         direction += horizont_right;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
+    if (input.IsHeld(GLFW_KEY_SPACE)) {
         direction += world_up;
     }
 
@@ -54,7 +54,7 @@ glm::vec3 Camera::ProcessInput(GLFWwindow* window, GLfloat delta_time)
 
     float movement_speed = (is_sprint_toggled) ? movement_speed_sprint : movement_speed_normal;
 
-    return direction == zero ? zero : glm::normalize(direction) * movement_speed * delta_time;
+    return direction == zero ? zero : glm::normalize(direction) * movement_speed * input.delta_time;
 }
 
 void Camera::ProcessMouseMovement(GLfloat xoffset, GLfloat yoffset)
@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 
 #include "AudioSlave.hpp"
+#include "InputRecorder.hpp"
 
 class Camera
 {
@@ -29,7 +30,7 @@ public:
 
     Camera(glm::vec3 position);
     glm::mat4 GetViewMatrix();
-    glm::vec3 ProcessInput(GLFWwindow* window, GLfloat deltaTime);
+    glm::vec3 ProcessInput(const InputFrame& input); // Movement of this frame
     void ProcessMouseMovement(GLfloat xoffset, GLfloat yoffset);
 
     void ToggleSprint();
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+#include "ClusteredLights.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+//
+// http://www.aortiz.me/2018/12/21/CG.html
+//
+
+void ClusteredLights::Init()
+{
+    glCreateBuffers(1, &lights_SSBO);
+    glCreateBuffers(1, &clusters_SSBO);
+    glCreateBuffers(1, &indices_SSBO);
+}
+
+void ClusteredLights::Clear()
+{
+    glDeleteBuffers(1, &lights_SSBO);
+    glDeleteBuffers(1, &clusters_SSBO);
+    glDeleteBuffers(1, &indices_SSBO);
+    lights_SSBO = clusters_SSBO = indices_SSBO = 0;
+}
+
+void ClusteredLights::BeginFrame()
+{
+    lights.clear();
+}
+
+void ClusteredLights::AddLight(const PointLight& light)
+{
+    // Distance where attenuation * brightest channel == LIGHT_CUTOFF: exponent * d^2 + linear * d + constant - max / cutoff = 0
+    float brightest = std::max({ light.diffuse.r, light.diffuse.g, light.diffuse.b, light.specular.r, light.specular.g, light.specular.b });
+    float c = light.constant - brightest / LIGHT_CUTOFF;
+    float radius = 0.0f;
+    if (c < 0.0f) {
+        radius = light.exponent > 0.0f
+            ? (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.exponent * c)) / (2.0f * light.exponent)
+            : -c / std::max(light.linear, 1e-6f);
+    }
+    if (radius <= 0.0f) return; // Too dark to matter
+
+    lights.push_back({
+        glm::vec4(light.position, radius),
+        glm::vec4(light.diffuse, 0.0f),
+        glm::vec4(light.specular, 0.0f),
+        glm::vec4(light.constant, light.linear, light.exponent, 0.0f) });
+}
+
+int ClusteredLights::GetSlice(float depth) const
+{
+    // Slices grow exponentially with depth, so they are roughly cube shaped
+    return static_cast<int>(std::floor(std::log(depth / near) * CLUSTERS_Z / std::log(far / near)));
+}
+
+bool ClusteredLights::GetClusterRange(const GPULight& light, const glm::mat4& mx_view, const glm::mat4& mx_projection, ClusterRange& range) const
+{
+    glm::vec3 center = glm::vec3(mx_view * glm::vec4(glm::vec3(light.position_radius), 1.0f));
+    float radius = light.position_radius.w;
+
+    // View space looks down -z
+    float depth_min = std::max(-center.z - radius, near);
+    float depth_max = std::min(-center.z + radius, far);
+    if (depth_min > depth_max) return false;
+    range.min_z = std::clamp(GetSlice(depth_min), 0, CLUSTERS_Z - 1);
+    range.max_z = std::clamp(GetSlice(depth_max), 0, CLUSTERS_Z - 1);
+
+    // Screen rectangle of the box around sphere; x / depth is extreme in the box corners
+    float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX;
+    for (float depth : { depth_min, depth_max }) {
+        for (float x : { center.x - radius, center.x + radius }) {
+            float ndc_x = mx_projection[0][0] * x / depth;
+            min_x = std::min(min_x, ndc_x);
+            max_x = std::max(max_x, ndc_x);
+        }
+        for (float y : { center.y - radius, center.y + radius }) {
+            float ndc_y = mx_projection[1][1] * y / depth;
+            min_y = std::min(min_y, ndc_y);
+            max_y = std::max(max_y, ndc_y);
+        }
+    }
+    if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) return false;
+    range.min_x = std::clamp(static_cast<int>((min_x * 0.5f + 0.5f) * CLUSTERS_X), 0, CLUSTERS_X - 1);
+    range.max_x = std::clamp(static_cast<int>((max_x * 0.5f + 0.5f) * CLUSTERS_X), 0, CLUSTERS_X - 1);
+    range.min_y = std::clamp(static_cast<int>((min_y * 0.5f + 0.5f) * CLUSTERS_Y), 0, CLUSTERS_Y - 1);
+    range.max_y = std::clamp(static_cast<int>((max_y * 0.5f + 0.5f) * CLUSTERS_Y), 0, CLUSTERS_Y - 1);
+    return true;
+}
+
+void ClusteredLights::Update(const glm::mat4& mx_view, const glm::mat4& mx_projection, float near, float far)
+{
+    this->near = near;
+    this->far = far;
+
+    // [1] Clusters touched by each light, and count lights per cluster
+    std::fill(clusters.begin(), clusters.end(), glm::uvec2(0));
+    light_ranges.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        auto& range = light_ranges[i];
+        if (!GetClusterRange(lights[i], mx_view, mx_projection, range)) {
+            range = { 0, -1, 0, -1, 0, -1 }; // Empty
+            continue;
+        }
+        for (int z = range.min_z; z <= range.max_z; z++)
+            for (int y = range.min_y; y <= range.max_y; y++)
+                for (int x = range.min_x; x <= range.max_x; x++)
+                    clusters[(z * CLUSTERS_Y + y) * CLUSTERS_X + x].y++;
+    }
+
+    // [2] Offsets of cluster lists (prefix sum)
+    GLuint offset = 0;
+    for (auto& cluster : clusters) {
+        cluster.x = offset;
+        offset += cluster.y;
+        cluster.y = 0;
+    }
+
+    // [3] Fill the lists
+    light_indices.resize(std::max<GLuint>(offset, 1)); // Empty SSBOs are not allowed
+    for (size_t i = 0; i < lights.size(); i++) {
+        const auto& range = light_ranges[i];
+        for (int z = range.min_z; z <= range.max_z; z++)
+            for (int y = range.min_y; y <= range.max_y; y++)
+                for (int x = range.min_x; x <= range.max_x; x++) {
+                    auto& cluster = clusters[(z * CLUSTERS_Y + y) * CLUSTERS_X + x];
+                    light_indices[cluster.x + cluster.y++] = static_cast<GLuint>(i);
+                }
+    }
+    print("ClusteredLights: " << lights.size() << " lights, " << offset << " light-cluster pairs");
+
+    // Upload; new storage every frame, so the driver never waits for the previous frame
+    glNamedBufferData(lights_SSBO, std::max<size_t>(lights.size(), 1) * sizeof(GPULight), lights.empty() ? nullptr : lights.data(), GL_STREAM_DRAW);
+    glNamedBufferData(clusters_SSBO, clusters.size() * sizeof(glm::uvec2), clusters.data(), GL_STREAM_DRAW);
+    glNamedBufferData(indices_SSBO, light_indices.size() * sizeof(GLuint), light_indices.data(), GL_STREAM_DRAW);
+}
+
+void ClusteredLights::Bind(ShaderProgram& shader, int width, int height)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lights_SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusters_SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indices_SSBO);
+
+    shader.SetUniform("u_cluster_scale", glm::vec3(
+        static_cast<float>(CLUSTERS_X) / std::max(width, 1),
+        static_cast<float>(CLUSTERS_Y) / std::max(height, 1),
+        CLUSTERS_Z / std::log(far / near)));
+    shader.SetUniform("u_near", near);
+    shader.SetUniform("u_far", far);
+}
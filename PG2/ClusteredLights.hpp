@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+
+#define CLUSTERS_X 16 // View frustum is divided into X*Y tiles on screen ...
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24 // ... and Z exponentially distributed depth slices
+#define LIGHT_CUTOFF (1.0f / 256.0f) // Light radius: distance where attenuated diffuse drops below this
+
+// Clustered forward shading of point lights
+// - lights are binned into view frustum clusters on CPU every frame, uber.frag evaluates only the lights of its cluster
+// - SSBOs: 0 = lights, 1 = clusters (offset + count into light indices), 2 = light indices
+class ClusteredLights
+{
+public:
+    struct PointLight {
+        glm::vec3 position{};
+        glm::vec3 diffuse{};
+        glm::vec3 specular{};
+        float constant = 1.0f;
+        float linear = 0.0f;
+        float exponent = 1.0f;
+    };
+
+    void Init();
+    void Clear();
+
+    void BeginFrame();                         // Remove all lights
+    void AddLight(const PointLight& light);    // World space
+    void Update(const glm::mat4& mx_view, const glm::mat4& mx_projection, float near, float far); // Bin lights into clusters and upload
+    void Bind(ShaderProgram& shader, int width, int height); // Bind SSBOs, set uniforms of the shader (active)
+
+    size_t GetLightCount() const { return lights.size(); }
+private:
+    struct GPULight { // std430
+        glm::vec4 position_radius;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+        glm::vec4 attenuation; // constant, linear, exponent, -
+    };
+    std::vector<GPULight> lights;
+
+    struct ClusterRange { // Clusters touched by a light
+        int min_x, max_x, min_y, max_y, min_z, max_z;
+    };
+    std::vector<ClusterRange> light_ranges;
+    std::vector<glm::uvec2> clusters = std::vector<glm::uvec2>(CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z); // offset, count
+    std::vector<GLuint> light_indices;
+
+    GLuint lights_SSBO{ 0 }, clusters_SSBO{ 0 }, indices_SSBO{ 0 };
+    float near = 0.1f, far = 1.0f;
+
+    bool GetClusterRange(const GPULight& light, const glm::mat4& mx_view, const glm::mat4& mx_projection, ClusterRange& range) const; // false if light is not in the frustum
+    int GetSlice(float depth) const;
+};
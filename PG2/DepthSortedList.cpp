@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "DepthSortedList.hpp"
+#include "Model.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+#define INSERTION_SORT_MAX_SHIFTS 8 // Give up insertion sort if items were shifted more than (this * number of items) times
+#define RADIX_SORT_MIN_ITEMS 64     // Below this, insertion sort is always faster
+
+void DepthSortedList::Add(Model* model)
+{
+    model->_draw_list_index = items.size();
+    items.push_back({ 0.0f, model });
+}
+
+void DepthSortedList::Remove(Model* model)
+{
+    // Swap with the last item and pop
+    auto index = model->_draw_list_index;
+    items[index] = items.back();
+    items[index].model->_draw_list_index = index;
+    items.pop_back();
+}
+
+void DepthSortedList::Sort(glm::vec3 camera_position)
+{
+    // Squared distance keeps the order and saves sqrt
+    for (auto& item : items) {
+        const auto& bounds = item.model->world_bounds;
+        glm::vec3 to_camera = camera_position - glm::vec3(bounds);
+        if (is_far_to_near) {
+            item.depth = glm::dot(to_camera, to_camera);
+        }
+        else {
+            // Distance to the bounding sphere instead of its center (camera is inside the heightmap's sphere -> drawn first)
+            item.depth = -std::max(0.0f, glm::dot(to_camera, to_camera) - bounds.w * bounds.w);
+        }
+    }
+
+    if (!InsertionSort()) {
+        print("DepthSortedList: insertion sort gave up, radix sort");
+        RadixSort();
+    }
+
+    for (size_t i = 0; i < items.size(); i++) {
+        items[i].model->_draw_list_index = i;
+    }
+}
+
+bool DepthSortedList::InsertionSort()
+{
+    // Almost sorted (coherent camera movement) -> close to O(n)
+    size_t max_shifts = items.size() < RADIX_SORT_MIN_ITEMS ? SIZE_MAX : INSERTION_SORT_MAX_SHIFTS * items.size();
+    size_t shifts = 0;
+    for (size_t i = 1; i < items.size(); i++) {
+        Item item = items[i];
+        size_t j = i;
+        while (j > 0 && items[j - 1].depth < item.depth) {
+            items[j] = items[j - 1];
+            j--;
+        }
+        items[j] = item;
+        shifts += i - j;
+        if (shifts > max_shifts) return false;
+    }
+    return true;
+}
+
+void DepthSortedList::RadixSort()
+{
+    // LSD radix sort, 4 passes of 8 bits
+    // Float bits with flipped sign bit (all bits for negative floats) have the same order as the floats, inverted give descending order
+    radix_buffer.resize(items.size());
+    auto key = [](const Item& item) {
+        uint32_t bits;
+        std::memcpy(&bits, &item.depth, sizeof(bits));
+        bits ^= (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+        return ~bits;
+    };
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t counts[256]{};
+        for (const auto& item : items) {
+            counts[(key(item) >> shift) & 0xFF]++;
+        }
+        // All items in one bucket -> this pass would not change anything
+        if (counts[(key(items[0]) >> shift) & 0xFF] == items.size()) continue;
+
+        size_t offset = 0;
+        for (auto& count : counts) {
+            size_t n = count;
+            count = offset;
+            offset += n;
+        }
+        for (const auto& item : items) {
+            radix_buffer[counts[(key(item) >> shift) & 0xFF]++] = item;
+        }
+        items.swap(radix_buffer);
+    }
+}
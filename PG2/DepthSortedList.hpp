@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class Model;
+
+// Models sorted by squared distance from camera
+// - far to near for transparent models (blending), near to far for opaque models (less overdraw)
+// - order from the previous frame is kept, so usually only a few items move (insertion sort)
+// - if too many items move, falls back to radix sort
+class DepthSortedList
+{
+public:
+    DepthSortedList(bool is_far_to_near) : is_far_to_near(is_far_to_near) {}
+
+    void Add(Model* model);
+    void Remove(Model* model); // O(1), order is repaired by the next Sort()
+    void Sort(glm::vec3 camera_position); // Uses Model::world_bounds, call after culling
+
+    size_t Size() const { return items.size(); }
+    Model* operator[](size_t i) const { return items[i].model; }
+private:
+    bool is_far_to_near;
+
+    struct Item {
+        float depth; // items are sorted by this from the biggest; squared distance from camera (negated if near to far)
+        Model* model;
+    };
+    std::vector<Item> items;
+    std::vector<Item> radix_buffer;
+
+    bool InsertionSort(); // Returns false if it gave up because the order changed too much
+    void RadixSort();
+};
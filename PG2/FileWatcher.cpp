@@ -0,0 +1,56 @@
+#include <iostream>
+
+#include "FileWatcher.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void FileWatcher::Start(const std::filesystem::path& directory)
+{
+    Stop();
+    this->directory = directory;
+    write_times.clear();
+    Scan(); // Current state is not a change
+    is_changed = false;
+    is_running = true;
+    thread = std::thread(&FileWatcher::Watch, this);
+}
+
+void FileWatcher::Stop()
+{
+    is_running = false;
+    if (thread.joinable()) thread.join();
+}
+
+bool FileWatcher::HasChanged()
+{
+    return is_changed.exchange(false);
+}
+
+void FileWatcher::Watch()
+{
+    while (is_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FILE_WATCHER_INTERVAL_MS));
+        if (Scan()) {
+            print("FileWatcher: change in " << directory);
+            is_changed = true;
+        }
+    }
+}
+
+bool FileWatcher::Scan()
+{
+    // Errors (file being written, directory renamed) just mean "try again next time"
+    std::error_code ec;
+    std::map<std::filesystem::path, std::filesystem::file_time_type> current;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        auto write_time = entry.last_write_time(ec);
+        if (ec) return false;
+        current[entry.path()] = write_time;
+    }
+    if (ec) return false;
+
+    bool is_different = current != write_times;
+    write_times = std::move(current);
+    return is_different;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <thread>
+
+#define FILE_WATCHER_INTERVAL_MS 250 // How often watched directory is scanned
+
+// Watches files in a directory (not recursive) for changes, on its own thread
+// - main thread only asks HasChanged() once per frame, nothing is ever waited for
+class FileWatcher
+{
+public:
+    void Start(const std::filesystem::path& directory);
+    void Stop();
+    bool HasChanged(); // Any file was added, removed or modified since the last call
+
+    ~FileWatcher() { Stop(); }
+private:
+    std::filesystem::path directory;
+    std::thread thread;
+    std::atomic<bool> is_running{ false };
+    std::atomic<bool> is_changed{ false };
+
+    std::map<std::filesystem::path, std::filesystem::file_time_type> write_times; // Worker only
+    void Watch();
+    bool Scan(); // true if anything differs from write_times
+};
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "FrameStats.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+FrameStats::FrameStats(size_t capacity)
+{
+    frames.resize(capacity);
+    sorted.reserve(capacity);
+}
+
+void FrameStats::AddFrame(double timestamp, float frame_ms, float cpu_ms)
+{
+    frames[next] = { frame_number++, timestamp, frame_ms, cpu_ms, 0.0f };
+    next = (next + 1) % frames.size();
+    count = std::min(count + 1, frames.size());
+}
+
+void FrameStats::SetGPUTime(uint64_t frame, float gpu_ms)
+{
+    if (frame >= frame_number || frame_number - frame > count) return;
+    frames[(next + frames.size() - (frame_number - frame)) % frames.size()].gpu_ms = gpu_ms;
+}
+
+float FrameStats::GetFPS() const
+{
+    if (count == 0) return 0.0f;
+    const Frame& last = frames[(next + frames.size() - 1) % frames.size()];
+    int n = 0;
+    for (size_t i = 1; i <= count; i++) {
+        if (last.timestamp - frames[(next + frames.size() - i) % frames.size()].timestamp >= 1.0) break;
+        n++;
+    }
+    return static_cast<float>(n);
+}
+
+void FrameStats::Summarize(float Frame::* time, Summary& summary)
+{
+    sorted.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (frames[i].*time > 0.0f) sorted.push_back(frames[i].*time);
+    }
+    summary = Summary();
+    if (sorted.empty()) return;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [this](float p) { return sorted[std::min(static_cast<size_t>(p * sorted.size()), sorted.size() - 1)]; };
+    double sum = 0.0;
+    for (float time : sorted) {
+        sum += time;
+        int bin = std::min(static_cast<int>(time / FRAME_STATS_HISTOGRAM_BIN), FRAME_STATS_HISTOGRAM_BINS - 1);
+        summary.histogram[bin]++;
+    }
+    summary.frames = static_cast<int>(sorted.size());
+    summary.min = sorted.front();
+    summary.max = sorted.back();
+    summary.avg = static_cast<float>(sum / sorted.size());
+    summary.p50 = percentile(0.50f);
+    summary.p95 = percentile(0.95f);
+    summary.p99 = percentile(0.99f);
+
+    // Slowest 1%, at least one frame
+    size_t n_low = std::max<size_t>(1, sorted.size() / 100);
+    double low_sum = 0.0;
+    for (size_t i = sorted.size() - n_low; i < sorted.size(); i++) low_sum += sorted[i];
+    summary.low_1 = static_cast<float>(low_sum / n_low);
+
+    float hitch = FRAME_STATS_HITCH_FACTOR * summary.p50;
+    summary.hitches = static_cast<int>(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), hitch));
+}
+
+const FrameStats::Summary& FrameStats::GetFrameSummary()
+{
+    Summarize(&Frame::frame_ms, frame_summary);
+    return frame_summary;
+}
+
+const FrameStats::Summary& FrameStats::GetCPUSummary()
+{
+    Summarize(&Frame::cpu_ms, cpu_summary);
+    return cpu_summary;
+}
+
+const FrameStats::Summary& FrameStats::GetGPUSummary()
+{
+    Summarize(&Frame::gpu_ms, gpu_summary);
+    return gpu_summary;
+}
+
+bool FrameStats::SaveCSV(const std::filesystem::path& path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "FrameStats: Can not write " << path << "\n";
+        return false;
+    }
+    file << "frame,time_s,frame_ms,cpu_ms,gpu_ms\n" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < count; i++) {
+        const Frame& frame = frames[(next + frames.size() - count + i) % frames.size()]; // Oldest first
+        file << frame.number << "," << frame.timestamp << "," << frame.frame_ms << "," << frame.cpu_ms << "," << frame.gpu_ms << "\n";
+    }
+    return file.good();
+}
+
+bool FrameStats::SaveSummaryCSV(const std::filesystem::path& path)
+{
+    const Summary& all = GetFrameSummary();
+    const Summary& cpu = GetCPUSummary();
+    const Summary& gpu = GetGPUSummary();
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "FrameStats: Can not write " << path << "\n";
+        return false;
+    }
+    file << "metric,frame,cpu,gpu\n" << std::fixed << std::setprecision(4);
+    file << "frames," << all.frames << "," << cpu.frames << "," << gpu.frames << "\n";
+    file << "min_ms," << all.min << "," << cpu.min << "," << gpu.min << "\n";
+    file << "avg_ms," << all.avg << "," << cpu.avg << "," << gpu.avg << "\n";
+    file << "p50_ms," << all.p50 << "," << cpu.p50 << "," << gpu.p50 << "\n";
+    file << "p95_ms," << all.p95 << "," << cpu.p95 << "," << gpu.p95 << "\n";
+    file << "p99_ms," << all.p99 << "," << cpu.p99 << "," << gpu.p99 << "\n";
+    file << "max_ms," << all.max << "," << cpu.max << "," << gpu.max << "\n";
+    file << "low_1_ms," << all.low_1 << "," << cpu.low_1 << "," << gpu.low_1 << "\n";
+    file << "hitches," << all.hitches << "," << cpu.hitches << "," << gpu.hitches << "\n";
+    for (int i = 0; i < FRAME_STATS_HISTOGRAM_BINS; i++) {
+        file << std::setprecision(0) << "histogram_" << i * FRAME_STATS_HISTOGRAM_BIN << "_ms," << all.histogram[i] << "," << cpu.histogram[i] << "," << gpu.histogram[i] << "\n";
+    }
+    return file.good();
+}
+
+void FrameStats::Print()
+{
+    const Summary& all = GetFrameSummary();
+    std::cout << std::fixed << std::setprecision(2)
+        << "Frames: " << all.frames << " | min " << all.min << " avg " << all.avg << " p50 " << all.p50 << " p95 " << all.p95
+        << " p99 " << all.p99 << " max " << all.max << " | 1% low " << all.low_1 << " ms | " << all.hitches << " hitches\n";
+    const Summary& cpu = GetCPUSummary();
+    std::cout << "CPU: min " << cpu.min << " avg " << cpu.avg << " p50 " << cpu.p50 << " p95 " << cpu.p95
+        << " p99 " << cpu.p99 << " max " << cpu.max << " | 1% low " << cpu.low_1 << " ms\n";
+    const Summary& gpu = GetGPUSummary();
+    if (gpu.frames) {
+        std::cout << "GPU: min " << gpu.min << " avg " << gpu.avg << " p50 " << gpu.p50 << " p95 " << gpu.p95
+            << " p99 " << gpu.p99 << " max " << gpu.max << " | 1% low " << gpu.low_1 << " ms\n";
+    }
+    std::cout << std::defaultfloat;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#define FRAME_STATS_FRAMES 4096          // Frames kept for percentiles and the CSV (~1 minute at 60 FPS)
+#define FRAME_STATS_HITCH_FACTOR 2.0f    // Frame longer than this times the median is a hitch
+#define FRAME_STATS_REPORT_INTERVAL 0.5  // Seconds between window title updates
+#define FRAME_STATS_HISTOGRAM_BIN 2.0f   // ms per histogram bin
+#define FRAME_STATS_HISTOGRAM_BINS 25    // Last bin counts everything longer too
+
+// Per-frame times in a ring buffer
+// - frame time: the whole frame interval, including SwapBuffers (a V-Sync wait) and PollEvents, what the player sees
+// - CPU time: the frame up to SwapBuffers, the work of the app alone
+// - GPU time: from the GPU timer queries
+// - min/avg/p50/p95/p99/max, 1% low (average of the slowest 1% of frames) and hitches, which an averaged FPS hides
+// - statistics are computed only when asked for (a report every FRAME_STATS_REPORT_INTERVAL), AddFrame() just stores
+// - SaveCSV() writes every kept frame, SaveSummaryCSV() the statistics and histograms
+class FrameStats
+{
+public:
+    FrameStats(size_t capacity = FRAME_STATS_FRAMES); // Frames kept
+
+    void AddFrame(double timestamp, float frame_ms, float cpu_ms); // Once per frame, frames count from 0
+    void SetGPUTime(uint64_t frame, float gpu_ms);  // Known a few frames later, ignored if the frame is not kept anymore
+    bool IsReportDue(double timestamp) const { return timestamp - last_report >= FRAME_STATS_REPORT_INTERVAL; }
+    void SetReported(double timestamp) { last_report = timestamp; }
+
+    struct Summary {
+        int frames = 0;
+        float min = 0.0f, avg = 0.0f, p50 = 0.0f, p95 = 0.0f, p99 = 0.0f, max = 0.0f;
+        float low_1 = 0.0f; // ms
+        int hitches = 0;
+        int histogram[FRAME_STATS_HISTOGRAM_BINS]{};
+    };
+    const Summary& GetFrameSummary(); // Of the kept frames, computed now
+    const Summary& GetCPUSummary();
+    const Summary& GetGPUSummary();   // Frames without GPU time are left out
+    float GetFPS() const;             // Over the last second
+
+    bool SaveCSV(const std::filesystem::path& path) const;
+    bool SaveSummaryCSV(const std::filesystem::path& path);
+    void Print(); // Summary to the console
+private:
+    struct Frame {
+        uint64_t number;
+        double timestamp;
+        float frame_ms;
+        float cpu_ms;
+        float gpu_ms; // 0 = unknown
+    };
+    std::vector<Frame> frames; // Ring
+    size_t next = 0;
+    size_t count = 0;
+    uint64_t frame_number = 0;
+    double last_report = 0.0;
+
+    Summary frame_summary, cpu_summary, gpu_summary;
+    std::vector<float> sorted; // Reused
+    void Summarize(float Frame::* time, Summary& summary);
+};
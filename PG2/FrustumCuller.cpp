@@ -0,0 +1,115 @@
+#include <iostream>
+#include <immintrin.h>
+
+#include "FrustumCuller.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+#if defined(__AVX__)
+#define CULL_BATCH 8 // Spheres tested at once (AVX)
+#else
+#define CULL_BATCH 4 // Spheres tested at once (SSE)
+#endif
+
+//
+// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+//
+
+void FrustumCuller::SetFrustum(const glm::mat4& mx_view_projection)
+{
+    // GLM matrices are column major, mx[column][row]
+    const auto& mx = mx_view_projection;
+    glm::vec4 row_x(mx[0][0], mx[1][0], mx[2][0], mx[3][0]);
+    glm::vec4 row_y(mx[0][1], mx[1][1], mx[2][1], mx[3][1]);
+    glm::vec4 row_z(mx[0][2], mx[1][2], mx[2][2], mx[3][2]);
+    glm::vec4 row_w(mx[0][3], mx[1][3], mx[2][3], mx[3][3]);
+
+    planes[0] = row_w + row_x; // Left
+    planes[1] = row_w - row_x; // Right
+    planes[2] = row_w + row_y; // Bottom
+    planes[3] = row_w - row_y; // Top
+    planes[4] = row_w + row_z; // Near
+    planes[5] = row_w - row_z; // Far
+
+    // Normalize, so plane equation gives signed distance and can be compared with sphere radius
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+void FrustumCuller::Clear()
+{
+    // Vectors keep their capacity, so there are no allocations after the first few frames
+    centers_x.clear();
+    centers_y.clear();
+    centers_z.clear();
+    radii.clear();
+    n_spheres = 0;
+}
+
+size_t FrustumCuller::AddSphere(glm::vec4 sphere)
+{
+    centers_x.push_back(sphere.x);
+    centers_y.push_back(sphere.y);
+    centers_z.push_back(sphere.z);
+    radii.push_back(sphere.w);
+    return n_spheres++;
+}
+
+void FrustumCuller::Cull()
+{
+    // Pad arrays to whole batches; padding results are ignored
+    size_t n_padded = (n_spheres + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH;
+    centers_x.resize(n_padded, 0.0f);
+    centers_y.resize(n_padded, 0.0f);
+    centers_z.resize(n_padded, 0.0f);
+    radii.resize(n_padded, 0.0f);
+    visible.resize(n_padded);
+
+#if CULL_BATCH == 8
+    for (size_t i = 0; i < n_padded; i += 8) {
+        __m256 x = _mm256_loadu_ps(&centers_x[i]);
+        __m256 y = _mm256_loadu_ps(&centers_y[i]);
+        __m256 z = _mm256_loadu_ps(&centers_z[i]);
+        __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radii[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            // Sphere is outside if its center is further than its radius behind any plane
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_r, _CMP_GT_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int j = 0; j < 8; j++) {
+            visible[i + j] = (mask >> j) & 1;
+        }
+    }
+#else
+    for (size_t i = 0; i < n_padded; i += 4) {
+        __m128 x = _mm_loadu_ps(&centers_x[i]);
+        __m128 y = _mm_loadu_ps(&centers_y[i]);
+        __m128 z = _mm_loadu_ps(&centers_z[i]);
+        __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radii[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            // Sphere is outside if its center is further than its radius behind any plane
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, neg_r));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int j = 0; j < 4; j++) {
+            visible[i + j] = (mask >> j) & 1;
+        }
+    }
+#endif
+
+    visible_count = 0;
+    for (size_t i = 0; i < n_spheres; i++) {
+        visible_count += visible[i];
+    }
+    culled_count = static_cast<int>(n_spheres) - visible_count;
+    print("FrustumCuller: visible " << visible_count << ", culled " << culled_count);
+}
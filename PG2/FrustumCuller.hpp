@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// View-frustum culling of bounding spheres
+// - spheres are stored in SoA arrays and tested 8 (AVX) or 4 (SSE) at a time against all six frustum planes
+class FrustumCuller
+{
+public:
+    void SetFrustum(const glm::mat4& mx_view_projection); // Extract frustum planes from (projection * view) matrix
+    void Clear();                                         // Remove all spheres (call every frame before adding them again)
+    size_t AddSphere(glm::vec4 sphere);                   // World space bounding sphere: xyz center + w radius; returns its index
+    void Cull();                                          // Test all added spheres against the frustum
+
+    bool IsVisible(size_t index) const { return visible[index] != 0; }
+    int GetVisibleCount() const { return visible_count; }
+    int GetCulledCount() const { return culled_count; }
+private:
+    glm::vec4 planes[6]{}; // xyz normal (pointing inside the frustum) + w distance
+
+    // Spheres (SoA)
+    std::vector<float> centers_x;
+    std::vector<float> centers_y;
+    std::vector<float> centers_z;
+    std::vector<float> radii;
+    std::vector<unsigned char> visible; // Cull() result for each sphere
+    size_t n_spheres = 0;
+
+    // Statistics of the last Cull()
+    int visible_count = 0;
+    int culled_count = 0;
+};
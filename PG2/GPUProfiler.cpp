@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+#include "GPUProfiler.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void GPUProfiler::Init()
+{
+    is_available = GLEW_ARB_timer_query;
+    if (!is_available) {
+        std::cerr << "GPUProfiler: GL_ARB_timer_query not supported, no GPU times\n";
+        return;
+    }
+    for (auto& frame : frames) {
+        glGenQueries(static_cast<GLsizei>(std::size(frame.queries)), frame.queries);
+        frame.zones.reserve(GPU_PROFILER_ZONES);
+    }
+    history.resize(GPU_PROFILER_HISTORY);
+    track = Profiler::AddTrack("GPU");
+}
+
+void GPUProfiler::Clear()
+{
+    for (auto& frame : frames) {
+        if (frame.queries[0]) glDeleteQueries(static_cast<GLsizei>(std::size(frame.queries)), frame.queries);
+        std::fill(std::begin(frame.queries), std::end(frame.queries), 0);
+        frame.zones.clear();
+        frame.is_pending = false;
+    }
+    history.clear();
+    is_available = false;
+}
+
+void GPUProfiler::BeginFrame()
+{
+    if (!is_available) return;
+    current = (current + 1) % GPU_PROFILER_FRAMES;
+    Frame& frame = frames[current];
+    if (frame.is_pending) Read(frame);
+
+    // GPU clock -> CPU clock, both "now" (GPU time when the commands so far were processed)
+    GLint64 gpu_timestamp = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_timestamp);
+    frame.clock_offset = static_cast<int64_t>(Profiler::Now()) - gpu_timestamp;
+    frame.number = frame_number++;
+    frame.zones.clear();
+    frame.is_pending = true;
+    depth = 0;
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+}
+
+void GPUProfiler::EndFrame()
+{
+    if (!is_available) return;
+    glQueryCounter(frames[current].queries[1], GL_TIMESTAMP);
+}
+
+int GPUProfiler::Begin(const char* name)
+{
+    if (!is_available) return -1;
+    Frame& frame = frames[current];
+    if (frame.zones.size() == GPU_PROFILER_ZONES) return -1;
+    int zone = static_cast<int>(frame.zones.size());
+    frame.zones.push_back({ name, depth++ });
+    glQueryCounter(frame.queries[2 + 2 * zone], GL_TIMESTAMP);
+    return zone;
+}
+
+void GPUProfiler::End(int zone)
+{
+    if (zone < 0) return;
+    depth--;
+    glQueryCounter(frames[current].queries[2 + 2 * zone + 1], GL_TIMESTAMP);
+}
+
+void GPUProfiler::Read(Frame& frame)
+{
+    frame.is_pending = false;
+
+    // Timestamps are written in order, the last one of the frame tells if all are there
+    GLuint is_ready = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &is_ready);
+    if (!is_ready) {
+        dropped_count++;
+        print("GPUProfiler: frame " << frame.number << " not ready, dropped");
+        return;
+    }
+
+    GLuint64 timestamps[2 * (GPU_PROFILER_ZONES + 1)];
+    GLsizei n_queries = static_cast<GLsizei>(2 + 2 * frame.zones.size());
+    for (GLsizei i = 0; i < n_queries; i++) {
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+    frame_time = (timestamps[1] - timestamps[0]) / 1e6f;
+    frame_time_number = frame.number;
+    has_frame_time = true;
+
+    auto& results = history[history_next];
+    history_next = (history_next + 1) % history.size();
+    results.clear();
+    results.push_back({ frame.number, "Frame", 0, frame_time });
+    Profiler::AddZone(track, "Frame", timestamps[0] + frame.clock_offset, timestamps[1] + frame.clock_offset);
+    for (size_t i = 0; i < frame.zones.size(); i++) {
+        GLuint64 begin = timestamps[2 + 2 * i], end = timestamps[2 + 2 * i + 1];
+        results.push_back({ frame.number, frame.zones[i].name, frame.zones[i].depth + 1, (end - begin) / 1e6f });
+        Profiler::AddZone(track, frame.zones[i].name, begin + frame.clock_offset, end + frame.clock_offset);
+    }
+}
+
+bool GPUProfiler::TakeFrameTime(uint64_t& frame, float& ms)
+{
+    if (!has_frame_time) return false;
+    frame = frame_time_number;
+    ms = frame_time;
+    has_frame_time = false;
+    return true;
+}
+
+bool GPUProfiler::SaveCSV(const std::filesystem::path& path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "GPUProfiler: Can not write " << path << "\n";
+        return false;
+    }
+    file << "frame,zone,depth,ms\n" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < history.size(); i++) {
+        for (const auto& result : history[(history_next + i) % history.size()]) { // Oldest first
+            file << result.frame << "," << result.name << "," << result.depth << "," << result.ms << "\n";
+        }
+    }
+    return file.good();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <GL/glew.h>
+
+#define GPU_PROFILER_FRAMES 3      // Frames of queries in flight, results are read this many frames later (CPU never waits for GPU)
+#define GPU_PROFILER_ZONES 32      // Zones per frame at most, the rest are not measured
+#define GPU_PROFILER_HISTORY 1024  // Frames of results kept for SaveCSV()
+
+// GPU time of render passes from GL_TIMESTAMP queries
+// - each zone writes a timestamp at its beginning and end, so zones may nest (GL_TIME_ELAPSED queries can not)
+// - queries of a frame are read back GPU_PROFILER_FRAMES frames later, only if available; otherwise that frame is dropped
+// - GPU timestamps are moved to the CPU clock (offset taken every frame), zones appear on a "GPU" track of Profiler
+class GPUProfiler
+{
+public:
+    void Init(); // Valid GL context must exist
+    void Clear();
+
+    void BeginFrame(); // Before the first GL command of the frame
+    void EndFrame();   // Before SwapBuffers
+    int Begin(const char* name); // Name must be a string literal; returns zone for End(), -1 if not measured
+    void End(int zone);
+
+    bool SaveCSV(const std::filesystem::path& path) const; // frame, zone, ms of the last GPU_PROFILER_HISTORY frames
+    bool TakeFrameTime(uint64_t& frame, float& ms);        // Frame read back since the last call; frames count from the first BeginFrame()
+    int GetDroppedCount() const { return dropped_count; }  // Frames not read back in time
+private:
+    struct Zone {
+        const char* name;
+        int depth;
+    };
+    struct Frame {
+        GLuint queries[2 * (GPU_PROFILER_ZONES + 1)]{}; // Begin, end of the frame, then of each zone
+        std::vector<Zone> zones;
+        int64_t clock_offset = 0; // CPU ns - GPU ns when the frame began
+        uint64_t number = 0;
+        bool is_pending = false;
+    };
+    Frame frames[GPU_PROFILER_FRAMES];
+    int current = 0;
+    int depth = 0;
+    uint64_t frame_number = 0;
+    bool is_available = false;
+
+    struct Result {
+        uint64_t frame;
+        const char* name;
+        int depth;
+        float ms;
+    };
+    std::vector<std::vector<Result>> history; // Ring of GPU_PROFILER_HISTORY frames
+    size_t history_next = 0;
+    int track = 0;
+    float frame_time = 0.0f;
+    uint64_t frame_time_number = 0;
+    bool has_frame_time = false;
+    int dropped_count = 0;
+
+    void Read(Frame& frame);
+};
+
+// GPU zone from construction to End() or the end of the scope
+class GPUProfilerZone
+{
+public:
+    GPUProfilerZone(GPUProfiler& profiler, const char* name) : profiler(profiler), zone(profiler.Begin(name)) {}
+    ~GPUProfilerZone() { End(); }
+    GPUProfilerZone(const GPUProfilerZone&) = delete;
+    GPUProfilerZone& operator=(const GPUProfilerZone&) = delete;
+
+    void End()
+    {
+        if (zone < 0) return;
+        profiler.End(zone);
+        zone = -1;
+    }
+private:
+    GPUProfiler& profiler;
+    int zone;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#define IMAGE_CHANNELS_ANY 0  // Gray images stay gray (1 channel), everything else becomes RGBA
+#define IMAGE_CHANNELS_GRAY 1
+#define IMAGE_CHANNELS_RGBA 4
+
+// 8-bit image as ImageDecoder returns it
+// - 1 channel (gray) or 4 channels (RGBA), rows tightly packed, top row first
+struct Image {
+    int width{};
+    int height{};
+    int channels{};
+    std::vector<unsigned char> pixels;
+
+    bool IsEmpty() const { return pixels.empty(); }
+    unsigned char* Row(int y) { return pixels.data() + static_cast<size_t>(y) * width * channels; }
+    const unsigned char* Row(int y) const { return pixels.data() + static_cast<size_t>(y) * width * channels; }
+    unsigned char At(int x, int y, int channel = 0) const { return Row(y)[x * channels + channel]; }
+};
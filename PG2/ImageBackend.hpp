@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+#include "Image.hpp"
+
+// File format decoder used by ImageDecoder
+// - Decode() is called from several threads at once, backends must not keep state
+class ImageBackend
+{
+public:
+    virtual ~ImageBackend() = default;
+
+    virtual const char* GetName() const = 0;
+    // false = not a format (or format variant) of this backend, the next one is tried
+    virtual bool Decode(const std::vector<unsigned char>& file, int channels, Image& image) const = 0;
+};
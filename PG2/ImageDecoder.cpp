@@ -0,0 +1,89 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "ImageDecoder.hpp"
+#include "LeanImageBackend.hpp"
+#include "Profiler.hpp"
+#if IMAGE_DECODER_OPENCV
+#include "OpenCVImageBackend.hpp"
+#endif
+
+#define print(x) //std::cout << x << "\n"
+
+void ImageDecoder::Start(unsigned n_threads)
+{
+    Stop();
+    if (n_threads == 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+    is_running = true;
+    for (unsigned i = 0; i < n_threads; i++) {
+        threads.emplace_back(&ImageDecoder::Work, this);
+    }
+    print("ImageDecoder: " << n_threads << " threads");
+}
+
+void ImageDecoder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_running = false;
+    }
+    has_job.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+void ImageDecoder::Work()
+{
+    PROFILE_THREAD("Image decoder");
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            has_job.wait(lock, [this]() { return !jobs.empty() || !is_running; });
+            if (jobs.empty()) return; // Stopped and nothing left
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::vector<std::unique_ptr<ImageBackend>>& ImageDecoder::GetBackends()
+{
+    static std::vector<std::unique_ptr<ImageBackend>> backends = []() {
+        std::vector<std::unique_ptr<ImageBackend>> defaults;
+        defaults.push_back(std::make_unique<LeanImageBackend>());
+#if IMAGE_DECODER_OPENCV
+        defaults.push_back(std::make_unique<OpenCVImageBackend>());
+#endif
+        return defaults;
+    }();
+    return backends;
+}
+
+void ImageDecoder::AddBackend(std::unique_ptr<ImageBackend> backend)
+{
+    GetBackends().push_back(std::move(backend));
+}
+
+Image ImageDecoder::Decode(const std::filesystem::path& path, int channels)
+{
+    PROFILE_ZONE("ImageDecoder::Decode");
+    Image image;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return image;
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    for (const auto& backend : GetBackends()) {
+        if (backend->Decode(bytes, channels, image)) {
+            print("ImageDecoder: " << path << " by " << backend->GetName());
+            return image;
+        }
+        image = Image();
+    }
+    std::cerr << "ImageDecoder: No backend can decode " << path << "\n";
+    return image;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ImageBackend.hpp"
+
+#define IMAGE_DECODER_THREADS 0 // Worker threads, 0 = one per hardware thread
+#define IMAGE_DECODER_OPENCV 0  // 1 = OpenCV backend after the built-in one (other formats, interlaced PNG, ...); needs OpenCV installed
+
+// Pool of worker threads for asset loading (image decode, texture cooking)
+// - Run() returns a future, the GL thread takes the results when it needs them
+// - without Start() (or after Stop()) jobs run on the calling thread
+// - files are decoded by the first backend that accepts them: LeanImageBackend (PNG, JPEG), then added ones
+class ImageDecoder
+{
+public:
+    void Start(unsigned n_threads = IMAGE_DECODER_THREADS);
+    void Stop(); // Finishes queued jobs
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Run(F job);
+
+    static Image Decode(const std::filesystem::path& path, int channels = IMAGE_CHANNELS_ANY); // IMAGE_CHANNELS_*; empty if it can not be read
+    static void AddBackend(std::unique_ptr<ImageBackend> backend);                             // Before any Decode()
+
+    ~ImageDecoder() { Stop(); }
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable has_job;
+    bool is_running = false;
+
+    static std::vector<std::unique_ptr<ImageBackend>>& GetBackends();
+
+    void Work();
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ImageDecoder::Run(F job)
+{
+    // std::function must be copyable, packaged_task is not
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(job));
+    auto future = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (is_running) {
+            jobs.push_back([task]() { (*task)(); });
+            has_job.notify_one();
+            return future;
+        }
+    }
+    (*task)();
+    return future;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+
+#include "InputRecorder.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+// Bits of InputFrame::keys
+static const int held_keys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE };
+
+bool InputFrame::IsHeld(int key) const
+{
+    auto it = std::find(std::begin(held_keys), std::end(held_keys), key);
+    return it != std::end(held_keys) && (keys >> (it - std::begin(held_keys)) & 1);
+}
+
+bool InputRecorder::StartRecording(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    record_file.open(path);
+    if (!record_file) {
+        std::cerr << "InputRecorder: Can not write " << path << "\n";
+        return false;
+    }
+    record_file << INPUT_FILE_HEADER << "\n" << std::setprecision(std::numeric_limits<double>::max_digits10); // Floats read back exactly
+    recorded_count = 0;
+    std::cout << "Recording input to " << path.string() << "\n";
+    return true;
+}
+
+bool InputRecorder::StartReplay(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    std::string header;
+    if (!file || !std::getline(file, header) || header != INPUT_FILE_HEADER) {
+        std::cerr << "InputRecorder: " << path << " is not a recording (" INPUT_FILE_HEADER ")\n";
+        return false;
+    }
+    replay_frames.clear();
+    InputFrame frame;
+    size_t n_events;
+    while (file >> frame.timestamp >> frame.delta_time >> frame.keys >> frame.is_mouselook_on >> frame.look.x >> frame.look.y >> n_events) {
+        frame.events.resize(n_events);
+        for (auto& event : frame.events) {
+            int type;
+            file >> type >> event.code >> event.action >> event.mods >> event.offset;
+            event.type = static_cast<InputEvent::Type>(type);
+        }
+        if (!file) break;
+        replay_frames.push_back(frame);
+    }
+    if (!file.eof()) {
+        std::cerr << "InputRecorder: " << path << " damaged after frame " << replay_frames.size() << "\n";
+        return false;
+    }
+    replay_next = 0;
+    is_replaying = true;
+    std::cout << "Replaying " << replay_frames.size() << " frames of input from " << path.string() << "\n";
+    return true;
+}
+
+void InputRecorder::Stop()
+{
+    if (record_file.is_open()) {
+        record_file.close();
+        std::cout << "Recorded " << recorded_count << " frames of input\n";
+    }
+    if (is_replaying) {
+        std::cout << "Replayed " << replay_next << " of " << replay_frames.size() << " frames of input\n";
+        is_replaying = false;
+    }
+}
+
+void InputRecorder::AddEvent(const InputEvent& event)
+{
+    if (!is_replaying) events.push_back(event);
+}
+
+bool InputRecorder::NextFrame(GLFWwindow* window, double timestamp, float delta_time, bool is_mouselook_on, glm::dvec2 window_center, InputFrame& frame)
+{
+    if (is_replaying) {
+        if (replay_next == replay_frames.size()) return false;
+        frame = replay_frames[replay_next++];
+        return true;
+    }
+
+    frame.timestamp = timestamp;
+    frame.delta_time = delta_time;
+    frame.keys = 0;
+    frame.is_mouselook_on = is_mouselook_on;
+    for (int i = 0; i < static_cast<int>(std::size(held_keys)); i++) {
+        if (glfwGetKey(window, held_keys[i]) == GLFW_PRESS) frame.keys |= 1u << i;
+    }
+
+    // Mouse look: cursor offset from the window center, then back to the center
+    frame.look = glm::vec2(0.0f);
+    if (is_mouselook_on) {
+        double cursor_x, cursor_y;
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        frame.look = glm::vec2(window_center.x - cursor_x, window_center.y - cursor_y);
+        glfwSetCursorPos(window, window_center.x, window_center.y);
+    }
+
+    frame.events.swap(events);
+    events.clear();
+
+    if (record_file.is_open()) {
+        record_file << frame.timestamp << " " << frame.delta_time << " " << frame.keys << " " << frame.is_mouselook_on << " " << frame.look.x << " " << frame.look.y << " " << frame.events.size();
+        for (const auto& event : frame.events) {
+            record_file << " " << event.type << " " << event.code << " " << event.action << " " << event.mods << " " << event.offset;
+        }
+        record_file << "\n";
+        recorded_count++;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#define INPUT_FILE_HEADER "PG2 input 1" // First line of a recording, the format changes with the number
+
+// Something a GLFW callback reported, handled at the beginning of the next frame
+struct InputEvent {
+    enum Type { KEY, MOUSE_BUTTON, SCROLL };
+    Type type;
+    int code;      // GLFW key or mouse button
+    int action;    // GLFW_PRESS, GLFW_RELEASE, GLFW_REPEAT
+    int mods;
+    double offset; // Scroll
+};
+
+// Input of one frame, all the simulation reads
+struct InputFrame {
+    double timestamp = 0.0;  // glfwGetTime() when it was live
+    float delta_time = 0.0f;
+    unsigned keys = 0;       // Held movement keys, see IsHeld()
+    bool is_mouselook_on = false; // Before the events of the frame
+    glm::vec2 look{};        // Mouse look: cursor offset from the window center
+    std::vector<InputEvent> events;
+
+    bool IsHeld(int key) const; // W, S, A, D, Space
+};
+
+// Live input of every frame, optionally recorded to a file, or replayed from one
+// - replay gives the recorded frames in order with their recorded delta time, the wall clock is ignored,
+//   so the simulation goes through exactly the same states and two builds can be compared frame by frame
+// - callbacks must not add events while replaying, only leaving the app stays live
+// - text file: header line, then one line per frame: timestamp delta_time keys is_mouselook_on look.x look.y n_events [type code action mods offset]...
+class InputRecorder
+{
+public:
+    bool StartRecording(const std::filesystem::path& path);
+    bool StartReplay(const std::filesystem::path& path); // Whole file is read now, nothing is read while running
+    void Stop();
+
+    bool IsRecording() const { return record_file.is_open(); }
+    bool IsReplaying() const { return is_replaying; }
+
+    void AddEvent(const InputEvent& event); // From GLFW callbacks, belongs to the next frame
+    // Every frame before the simulation; false = replay is over
+    bool NextFrame(GLFWwindow* window, double timestamp, float delta_time, bool is_mouselook_on, glm::dvec2 window_center, InputFrame& frame);
+private:
+    std::vector<InputEvent> events; // Since the last frame
+    std::ofstream record_file;
+    uint64_t recorded_count = 0;
+
+    std::vector<InputFrame> replay_frames;
+    size_t replay_next = 0;
+    bool is_replaying = false;
+};
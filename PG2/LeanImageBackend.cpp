@@ -0,0 +1,89 @@
+#include <cstring>
+#include <iostream>
+#include <immintrin.h>
+
+#include "LeanImageBackend.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+bool LeanImageBackend::Decode(const std::vector<unsigned char>& file, int channels, Image& image) const
+{
+    static const unsigned char png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (file.size() >= 8 && std::memcmp(file.data(), png_signature, 8) == 0) {
+        return DecodePNG(file, channels, image);
+    }
+    if (file.size() >= 3 && file[0] == 0xFF && file[1] == 0xD8 && file[2] == 0xFF) {
+        return DecodeJPEG(file, channels, image);
+    }
+    return false;
+}
+
+void LeanImageBackend::ExpandRGB(const unsigned char* rgb, unsigned char* rgba, int n_pixels)
+{
+    // 4 pixels (12 bytes in, 16 bytes out) at a time; 16 bytes are loaded, so the last pixels go one by one
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    int i = 0;
+    for (; i + 6 <= n_pixels; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    for (; i < n_pixels; i++) {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+void LeanImageBackend::YCbCrToRGBA(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned char* rgba, int n_pixels)
+{
+    // JFIF: R = Y + 1.402 Cr, G = Y - 0.344 Cb - 0.714 Cr, B = Y + 1.772 Cb (Cb, Cr centered at 128)
+    // 8 pixels at a time in 16 bits: chroma << 7 times coefficient * 256 with rounding high multiply = chroma * coefficient
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i cr_r = _mm_set1_epi16(359), cb_g = _mm_set1_epi16(88), cr_g = _mm_set1_epi16(183), cb_b = _mm_set1_epi16(454);
+    const __m128i alpha = _mm_set1_epi8(-1);
+    int i = 0;
+    for (; i + 8 <= n_pixels; i += 8) {
+        __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)), zero);
+        __m128i cb16 = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb + i)), zero), bias), 7);
+        __m128i cr16 = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr + i)), zero), bias), 7);
+        __m128i r = _mm_add_epi16(y16, _mm_mulhrs_epi16(cr16, cr_r));
+        __m128i g = _mm_sub_epi16(_mm_sub_epi16(y16, _mm_mulhrs_epi16(cb16, cb_g)), _mm_mulhrs_epi16(cr16, cr_g));
+        __m128i b = _mm_add_epi16(y16, _mm_mulhrs_epi16(cb16, cb_b));
+        // Saturate to bytes and interleave RGBA
+        __m128i rb = _mm_packus_epi16(r, b);                            // r0..r7 b0..b7
+        __m128i ga = _mm_unpacklo_epi64(_mm_packus_epi16(g, g), alpha); // g0..g7 a0..a7
+        __m128i rg = _mm_unpacklo_epi8(rb, ga);                         // r0 g0 r1 g1 ...
+        __m128i ba = _mm_unpacklo_epi8(_mm_srli_si128(rb, 8), _mm_srli_si128(ga, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    for (; i < n_pixels; i++) {
+        int c_b = cb[i] - 128, c_r = cr[i] - 128;
+        int r = y[i] + ((359 * c_r + 128) >> 8);
+        int g = y[i] - ((88 * c_b + 183 * c_r + 128) >> 8);
+        int b = y[i] + ((454 * c_b + 128) >> 8);
+        rgba[i * 4 + 0] = static_cast<unsigned char>(std::min(255, std::max(0, r)));
+        rgba[i * 4 + 1] = static_cast<unsigned char>(std::min(255, std::max(0, g)));
+        rgba[i * 4 + 2] = static_cast<unsigned char>(std::min(255, std::max(0, b)));
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+void LeanImageBackend::RGBAToGray(const unsigned char* rgba, unsigned char* gray, int n_pixels)
+{
+    // Same weights as OpenCV (ITU-R BT.601)
+    for (int i = 0; i < n_pixels; i++) {
+        gray[i] = static_cast<unsigned char>((rgba[i * 4] * 4899 + rgba[i * 4 + 1] * 9617 + rgba[i * 4 + 2] * 1868 + 8192) >> 14);
+    }
+}
+
+void LeanImageBackend::GrayToRGBA(const unsigned char* gray, unsigned char* rgba, int n_pixels)
+{
+    for (int i = 0; i < n_pixels; i++) {
+        rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = gray[i];
+        rgba[i * 4 + 3] = 255;
+    }
+}
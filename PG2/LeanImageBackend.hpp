@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "ImageBackend.hpp"
+
+// Built-in PNG and JPEG decoder, no libraries needed
+// - PNG: all color types and bit depths (16-bit is reduced to 8), not interlaced
+// - JPEG: baseline and progressive, Huffman coded, 8-bit gray or YCbCr, any chroma subsampling
+// - color is written as RGBA with SSSE3 (RGB expansion, YCbCr conversion), as TextureCook() and GL take it
+// - PNG can be written too (screenshots of the headless mode), fast deflate with fixed codes
+class LeanImageBackend : public ImageBackend
+{
+public:
+    const char* GetName() const override { return "Lean"; }
+    bool Decode(const std::vector<unsigned char>& file, int channels, Image& image) const override;
+
+    static bool Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out); // zlib stream, out must be sized to the expected length
+    static void Deflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out); // zlib stream appended to out
+    static std::vector<unsigned char> EncodePNG(const Image& image);                              // Gray or RGBA, whole file
+private:
+    static bool DecodePNG(const std::vector<unsigned char>& file, int channels, Image& image);  // LeanImageBackendPNG.cpp
+    static bool DecodeJPEG(const std::vector<unsigned char>& file, int channels, Image& image); // LeanImageBackendJPEG.cpp
+
+    // Shared pixel conversions
+    static void ExpandRGB(const unsigned char* rgb, unsigned char* rgba, int n_pixels);
+    static void YCbCrToRGBA(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned char* rgba, int n_pixels);
+    static void RGBAToGray(const unsigned char* rgba, unsigned char* gray, int n_pixels);
+    static void GrayToRGBA(const unsigned char* gray, unsigned char* rgba, int n_pixels);
+};
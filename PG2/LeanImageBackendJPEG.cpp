@@ -0,0 +1,614 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "LeanImageBackend.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+//
+// ITU T.81 (JPEG), baseline and progressive DCT, Huffman coding
+//
+
+namespace {
+
+// Zigzag order -> natural order; extra entries catch k == 64 in corrupt streams
+const int zigzag[64 + 16] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+   63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+};
+
+// Entropy coded data is read from the most significant bit; 0xFF 0x00 is a stuffed 0xFF, any other 0xFF xx ends the segment
+struct BitReader {
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    uint32_t bits = 0;
+    int count = 0;
+    bool is_at_marker = false;
+
+    void Fill()
+    {
+        while (count <= 24) {
+            unsigned byte = 0; // Zeros after the end of the segment
+            if (!is_at_marker && pos < size) {
+                byte = data[pos];
+                if (byte != 0xFF) pos++;
+                else if (pos + 1 < size && data[pos + 1] == 0x00) pos += 2;
+                else { is_at_marker = true; byte = 0; }
+            }
+            bits |= byte << (24 - count);
+            count += 8;
+        }
+    }
+    unsigned GetBits(int n)
+    {
+        if (n == 0) return 0;
+        if (count < n) Fill();
+        unsigned value = bits >> (32 - n);
+        bits <<= n;
+        count -= n;
+        return value;
+    }
+    unsigned GetBit() { return GetBits(1); }
+    int Receive(int n) // Next n bits as a signed coefficient (T.81 EXTEND)
+    {
+        int value = static_cast<int>(GetBits(n));
+        return n && value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+    }
+    void Restart()
+    {
+        // Rest of the byte is padding, RSTn marker follows
+        bits = 0;
+        count = 0;
+        is_at_marker = false;
+        while (pos + 1 < size && !(data[pos] == 0xFF && data[pos + 1] >= 0xD0 && data[pos + 1] <= 0xD7)) pos++;
+        pos += 2;
+    }
+};
+
+// Canonical Huffman code; codes up to 9 bits are looked up, longer ones compared against the max. code of each length
+struct Huffman {
+    uint8_t fast_len[512]{};
+    uint8_t fast_symbol[512]{};
+    int max_code[17]{};
+    int first_index[17]{}; // Into symbols
+    int first_code[17]{};
+    uint8_t symbols[256]{};
+
+    void Build(const uint8_t counts[16], const uint8_t* values, int n)
+    {
+        std::memcpy(symbols, values, n);
+        std::memset(fast_len, 0, sizeof(fast_len));
+        int code = 0, index = 0;
+        for (int len = 1; len <= 16; len++) {
+            first_index[len] = index;
+            first_code[len] = code;
+            for (int i = 0; i < counts[len - 1]; i++, code++, index++) {
+                if (len <= 9) {
+                    for (int j = code << (9 - len); j < (code + 1) << (9 - len); j++) {
+                        fast_len[j] = static_cast<uint8_t>(len);
+                        fast_symbol[j] = symbols[index];
+                    }
+                }
+            }
+            max_code[len] = counts[len - 1] ? code - 1 : -1;
+            code <<= 1;
+        }
+    }
+
+    int Decode(BitReader& reader) const
+    {
+        if (reader.count < 16) reader.Fill();
+        unsigned peek = reader.bits >> 23;
+        if (fast_len[peek]) {
+            reader.GetBits(fast_len[peek]);
+            return fast_symbol[peek];
+        }
+        for (int len = 10; len <= 16; len++) {
+            int code = static_cast<int>(reader.bits >> (32 - len));
+            if (code <= max_code[len]) {
+                reader.GetBits(len);
+                return symbols[(first_index[len] + code - first_code[len]) & 255];
+            }
+        }
+        return -1;
+    }
+};
+
+struct Component {
+    int id, h, v, quant;
+    int dc_table, ac_table;   // Of the current scan
+    int width, height;        // Samples (less than the blocks cover)
+    int blocks_w, blocks_h;   // Whole MCUs
+    int dc_prediction;
+    std::vector<int16_t> coefficients; // 64 per block, natural order, not dequantized
+    std::vector<uint8_t> plane;        // After IDCT, blocks_w * 8 wide
+};
+
+struct Decoder {
+    const unsigned char* data;
+    size_t size;
+    size_t pos = 2;
+
+    int width = 0, height = 0;
+    bool is_progressive = false;
+    Component components[3];
+    int n_components = 0;
+    int h_max = 1, v_max = 1, mcus_x = 0, mcus_y = 0;
+    uint16_t quant[4][64]{};
+    Huffman dc_tables[4], ac_tables[4];
+    int restart_interval = 0;
+
+    // Current scan
+    Component* scan[3]{};
+    int n_scan = 0;
+    int spectral_start = 0, spectral_end = 63, approx_high = 0, approx_low = 0;
+    int eob_run = 0;
+    bool is_corrupt = false;
+
+    Decoder(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    int Read16() { int value = data[pos] << 8 | data[pos + 1]; pos += 2; return value; }
+
+    // Segments, p = after the length, len = without it
+    bool ReadFrame(const unsigned char* p, size_t len, bool progressive);
+    bool ReadHuffman(const unsigned char* p, size_t len);
+    bool ReadQuant(const unsigned char* p, size_t len);
+    bool ReadScan();
+    void DecodeBlock(BitReader& reader, Component& component, int16_t* block);
+    void RefineAC(BitReader& reader, Component& component, int16_t* block);
+    void Finish();
+};
+
+bool Decoder::ReadFrame(const unsigned char* p, size_t len, bool progressive)
+{
+    is_progressive = progressive;
+    if (len < 6 || p[0] != 8) return false; // 12-bit precision
+    height = p[1] << 8 | p[2];
+    width = p[3] << 8 | p[4];
+    n_components = p[5];
+    if (width == 0 || height == 0 || (n_components != 1 && n_components != 3)) return false; // Height in DNL, CMYK
+    if (len < 6 + static_cast<size_t>(n_components) * 3) return false;
+    for (int i = 0; i < n_components; i++) {
+        const unsigned char* c = &p[6 + i * 3];
+        auto& component = components[i];
+        component.id = c[0];
+        component.h = c[1] >> 4;
+        component.v = c[1] & 15;
+        component.quant = c[2] & 3;
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) return false;
+        h_max = std::max(h_max, component.h);
+        v_max = std::max(v_max, component.v);
+    }
+    mcus_x = (width + 8 * h_max - 1) / (8 * h_max);
+    mcus_y = (height + 8 * v_max - 1) / (8 * v_max);
+    for (int i = 0; i < n_components; i++) {
+        auto& component = components[i];
+        if (h_max % component.h || v_max % component.v) return false; // Upsampling needs integer factors
+        component.width = (width * component.h + h_max - 1) / h_max;
+        component.height = (height * component.v + v_max - 1) / v_max;
+        component.blocks_w = mcus_x * component.h;
+        component.blocks_h = mcus_y * component.v;
+        component.coefficients.assign(static_cast<size_t>(component.blocks_w) * component.blocks_h * 64, 0);
+    }
+    return true;
+}
+
+bool Decoder::ReadHuffman(const unsigned char* p, size_t len)
+{
+    const unsigned char* end = p + len;
+    while (p + 17 <= end) {
+        int table_class = p[0] >> 4, id = p[0] & 3;
+        const uint8_t* counts = &p[1];
+        int n = 0;
+        for (int i = 0; i < 16; i++) n += counts[i];
+        if (n > 256 || p + 17 + n > end) return false;
+        (table_class ? ac_tables : dc_tables)[id].Build(counts, &p[17], n);
+        p += 17 + n;
+    }
+    return true;
+}
+
+bool Decoder::ReadQuant(const unsigned char* p, size_t len)
+{
+    const unsigned char* end = p + len;
+    while (p < end) {
+        bool is_16bit = p[0] >> 4;
+        int id = p[0] & 3;
+        p++;
+        if (p + (is_16bit ? 128 : 64) > end) return false;
+        for (int i = 0; i < 64; i++) {
+            quant[id][zigzag[i]] = is_16bit ? static_cast<uint16_t>(p[i * 2] << 8 | p[i * 2 + 1]) : p[i];
+        }
+        p += is_16bit ? 128 : 64;
+    }
+    return true;
+}
+
+void Decoder::DecodeBlock(BitReader& reader, Component& component, int16_t* block)
+{
+    if (!is_progressive) {
+        // Baseline: whole block at once
+        int t = dc_tables[component.dc_table].Decode(reader);
+        if (t < 0 || t > 16) { is_corrupt = true; return; }
+        component.dc_prediction += reader.Receive(t);
+        block[0] = static_cast<int16_t>(component.dc_prediction);
+        const Huffman& ac = ac_tables[component.ac_table];
+        for (int k = 1; k < 64; ) {
+            int rs = ac.Decode(reader);
+            if (rs < 0) { is_corrupt = true; return; }
+            int r = rs >> 4, s = rs & 15;
+            if (s == 0) {
+                if (r != 15) break; // End of block
+                k += 16;
+                continue;
+            }
+            k += r;
+            block[zigzag[k]] = static_cast<int16_t>(reader.Receive(s));
+            k++;
+        }
+        return;
+    }
+
+    if (spectral_start == 0) {
+        // DC: first scan, or one more bit
+        if (approx_high == 0) {
+            int t = dc_tables[component.dc_table].Decode(reader);
+            if (t < 0 || t > 16) { is_corrupt = true; return; }
+            component.dc_prediction += reader.Receive(t);
+            block[0] = static_cast<int16_t>(component.dc_prediction * (1 << approx_low));
+        }
+        else if (reader.GetBit()) {
+            block[0] |= static_cast<int16_t>(1 << approx_low);
+        }
+        return;
+    }
+
+    if (approx_high != 0) {
+        RefineAC(reader, component, block);
+        return;
+    }
+
+    // AC first scan, runs of empty blocks are counted by eob_run
+    if (eob_run > 0) {
+        eob_run--;
+        return;
+    }
+    const Huffman& ac = ac_tables[component.ac_table];
+    for (int k = spectral_start; k <= spectral_end; ) {
+        int rs = ac.Decode(reader);
+        if (rs < 0) { is_corrupt = true; return; }
+        int r = rs >> 4, s = rs & 15;
+        if (s == 0) {
+            if (r < 15) {
+                eob_run = (1 << r) - 1 + static_cast<int>(reader.GetBits(r));
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        block[zigzag[k]] = static_cast<int16_t>(reader.Receive(s) * (1 << approx_low));
+        k++;
+    }
+}
+
+void Decoder::RefineAC(BitReader& reader, Component& component, int16_t* block)
+{
+    // Nonzero coefficients get one more bit each; new ones (+-1) are placed after r zero ones
+    int p1 = 1 << approx_low, m1 = -p1;
+    auto refine = [&](int16_t& coefficient) {
+        if (reader.GetBit() && (coefficient & p1) == 0) {
+            coefficient = static_cast<int16_t>(coefficient + (coefficient >= 0 ? p1 : m1));
+        }
+    };
+
+    int k = spectral_start;
+    if (eob_run == 0) {
+        const Huffman& ac = ac_tables[component.ac_table];
+        for (; k <= spectral_end; k++) {
+            int rs = ac.Decode(reader);
+            if (rs < 0) { is_corrupt = true; return; }
+            int r = rs >> 4, s = rs & 15;
+            if (s) {
+                s = reader.GetBit() ? p1 : m1;
+            }
+            else if (r != 15) {
+                eob_run = (1 << r) + static_cast<int>(reader.GetBits(r)); // This block included, see below
+                break;
+            }
+            // Skip r zero coefficients (refining the nonzero ones in between), then place the new one
+            for (; k <= spectral_end; k++) {
+                int16_t& coefficient = block[zigzag[k]];
+                if (coefficient != 0) refine(coefficient);
+                else if (--r < 0) break;
+            }
+            if (s && k <= 63) block[zigzag[k]] = static_cast<int16_t>(s);
+        }
+    }
+    if (eob_run > 0) {
+        for (; k <= spectral_end; k++) {
+            int16_t& coefficient = block[zigzag[k]];
+            if (coefficient != 0) refine(coefficient);
+        }
+        eob_run--;
+    }
+}
+
+bool Decoder::ReadScan()
+{
+    int len = Read16();
+    size_t header_end = pos + len - 2;
+    n_scan = data[pos];
+    if (n_scan < 1 || n_scan > n_components || header_end > size) return false;
+    for (int i = 0; i < n_scan; i++) {
+        int id = data[pos + 1 + i * 2], tables = data[pos + 2 + i * 2];
+        scan[i] = nullptr;
+        for (int c = 0; c < n_components; c++) {
+            if (components[c].id == id) scan[i] = &components[c];
+        }
+        if (!scan[i]) return false;
+        scan[i]->dc_table = tables >> 4 & 3;
+        scan[i]->ac_table = tables & 3;
+        scan[i]->dc_prediction = 0;
+    }
+    const unsigned char* p = &data[pos + 1 + n_scan * 2];
+    spectral_start = p[0];
+    spectral_end = std::min<int>(p[1], 63);
+    approx_high = p[2] >> 4;
+    approx_low = p[2] & 15;
+    if (!is_progressive) { spectral_start = 0; spectral_end = 63; approx_high = approx_low = 0; }
+    if (spectral_start > spectral_end || (spectral_start == 0 && spectral_end != 0 && is_progressive) || approx_low > 13) return false;
+    pos = header_end;
+    eob_run = 0;
+
+    BitReader reader{ data, size, pos };
+    if (n_scan == 1) {
+        // Not interleaved: blocks of one component in raster order, only those covering its samples
+        Component& component = *scan[0];
+        int blocks_x = (component.width + 7) / 8, blocks_y = (component.height + 7) / 8;
+        for (int i = 0; i < blocks_x * blocks_y && !is_corrupt; i++) {
+            if (restart_interval && i && i % restart_interval == 0) {
+                reader.Restart();
+                component.dc_prediction = 0;
+                eob_run = 0;
+            }
+            int bx = i % blocks_x, by = i / blocks_x;
+            DecodeBlock(reader, component, &component.coefficients[(static_cast<size_t>(by) * component.blocks_w + bx) * 64]);
+        }
+    }
+    else {
+        // Interleaved: MCU = h x v blocks of each component
+        for (int m = 0; m < mcus_x * mcus_y && !is_corrupt; m++) {
+            if (restart_interval && m && m % restart_interval == 0) {
+                reader.Restart();
+                for (int i = 0; i < n_scan; i++) scan[i]->dc_prediction = 0;
+                eob_run = 0;
+            }
+            int mx = m % mcus_x, my = m / mcus_x;
+            for (int i = 0; i < n_scan; i++) {
+                Component& component = *scan[i];
+                for (int y = 0; y < component.v; y++) {
+                    for (int x = 0; x < component.h; x++) {
+                        size_t block = static_cast<size_t>(my * component.v + y) * component.blocks_w + mx * component.h + x;
+                        DecodeBlock(reader, component, &component.coefficients[block * 64]);
+                    }
+                }
+            }
+        }
+    }
+    pos = reader.pos;
+    return !is_corrupt;
+}
+
+// Integer IDCT (Loeffler, Ligtenberg, Moschytz as in the IJG islow one), 12 fractional bits
+#define FIX(x) static_cast<int>((x) * 4096 + 0.5)
+
+struct Idct1D {
+    int t0, t1, t2, t3, x0, x1, x2, x3;
+
+    Idct1D(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7)
+    {
+        // Even part
+        int p1 = (s2 + s6) * FIX(0.5411961);
+        t2 = p1 + s6 * FIX(-1.847759065);
+        t3 = p1 + s2 * FIX(0.765366865);
+        t0 = (s0 + s4) * 4096;
+        t1 = (s0 - s4) * 4096;
+        x0 = t0 + t3;
+        x3 = t0 - t3;
+        x1 = t1 + t2;
+        x2 = t1 - t2;
+        // Odd part
+        t0 = s7; t1 = s5; t2 = s3; t3 = s1;
+        int p3 = t0 + t2, p4 = t1 + t3;
+        p1 = t0 + t3;
+        int p2 = t1 + t2;
+        int p5 = (p3 + p4) * FIX(1.175875602);
+        t0 *= FIX(0.298631336);
+        t1 *= FIX(2.053119869);
+        t2 *= FIX(3.072711026);
+        t3 *= FIX(1.501321110);
+        p1 = p5 + p1 * FIX(-0.899976223);
+        p2 = p5 + p2 * FIX(-2.562915447);
+        p3 *= FIX(-1.961570560);
+        p4 *= FIX(-0.390180644);
+        t3 += p1 + p4;
+        t2 += p2 + p3;
+        t1 += p2 + p4;
+        t0 += p1 + p3;
+    }
+};
+
+void Idct(const int16_t* block, const uint16_t* quant, uint8_t* out, int out_stride)
+{
+    // Valid streams stay far below these limits, corrupt ones must not overflow the fixed point math
+    auto limit = [](int x, int bound) { return std::min(bound - 1, std::max(-bound, x)); };
+
+    int values[64];
+    // Columns, 2 extra bits
+    for (int i = 0; i < 8; i++) {
+        int d[8];
+        bool is_dc_only = true;
+        for (int j = 0; j < 8; j++) {
+            d[j] = limit(block[j * 8 + i] * quant[j * 8 + i], 1 << 14);
+            if (j && d[j]) is_dc_only = false;
+        }
+        if (is_dc_only) {
+            for (int j = 0; j < 8; j++) values[j * 8 + i] = d[0] * 4;
+            continue;
+        }
+        Idct1D idct(d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7]);
+        idct.x0 += 512; idct.x1 += 512; idct.x2 += 512; idct.x3 += 512;
+        values[0 * 8 + i] = limit((idct.x0 + idct.t3) >> 10, 1 << 15);
+        values[7 * 8 + i] = limit((idct.x0 - idct.t3) >> 10, 1 << 15);
+        values[1 * 8 + i] = limit((idct.x1 + idct.t2) >> 10, 1 << 15);
+        values[6 * 8 + i] = limit((idct.x1 - idct.t2) >> 10, 1 << 15);
+        values[2 * 8 + i] = limit((idct.x2 + idct.t1) >> 10, 1 << 15);
+        values[5 * 8 + i] = limit((idct.x2 - idct.t1) >> 10, 1 << 15);
+        values[3 * 8 + i] = limit((idct.x3 + idct.t0) >> 10, 1 << 15);
+        values[4 * 8 + i] = limit((idct.x3 - idct.t0) >> 10, 1 << 15);
+    }
+    // Rows, remove the 12 + 2 + 3 (1/8 scale) bits, level shift by 128
+    auto clamp = [](int x) { return static_cast<uint8_t>(std::min(255, std::max(0, x))); };
+    for (int j = 0; j < 8; j++) {
+        const int* v = &values[j * 8];
+        Idct1D idct(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        const int bias = 65536 + (128 << 17);
+        idct.x0 += bias; idct.x1 += bias; idct.x2 += bias; idct.x3 += bias;
+        uint8_t* o = out + j * out_stride;
+        o[0] = clamp((idct.x0 + idct.t3) >> 17);
+        o[7] = clamp((idct.x0 - idct.t3) >> 17);
+        o[1] = clamp((idct.x1 + idct.t2) >> 17);
+        o[6] = clamp((idct.x1 - idct.t2) >> 17);
+        o[2] = clamp((idct.x2 + idct.t1) >> 17);
+        o[5] = clamp((idct.x2 - idct.t1) >> 17);
+        o[3] = clamp((idct.x3 + idct.t0) >> 17);
+        o[4] = clamp((idct.x3 - idct.t0) >> 17);
+    }
+}
+
+#undef FIX
+
+void Decoder::Finish()
+{
+    for (int c = 0; c < n_components; c++) {
+        auto& component = components[c];
+        int stride = component.blocks_w * 8;
+        component.plane.resize(static_cast<size_t>(stride) * component.blocks_h * 8);
+        for (int by = 0; by < component.blocks_h; by++) {
+            for (int bx = 0; bx < component.blocks_w; bx++) {
+                Idct(&component.coefficients[(static_cast<size_t>(by) * component.blocks_w + bx) * 64], quant[component.quant],
+                    &component.plane[static_cast<size_t>(by) * 8 * stride + bx * 8], stride);
+            }
+        }
+        component.coefficients = std::vector<int16_t>();
+    }
+}
+
+// Subsampled component row y at full resolution, bilinear between sample centers (same weights as libjpeg fancy upsampling for 2x)
+void UpsampleRow(const Component& component, int h_max, int v_max, int y, int width, uint8_t* out)
+{
+    int stride = component.blocks_w * 8;
+    int fx = h_max / component.h, fy = v_max / component.v;
+    // Position in samples, 4 fractional bits: (y + 0.5) / fy - 0.5
+    int sy = ((2 * y + 1) * 16 / fy - 16) / 2;
+    int y0 = std::max(0, sy >> 4), y1 = std::min(component.height - 1, (sy >> 4) + 1);
+    int wy = sy < 0 ? 0 : sy & 15;
+    const uint8_t* row0 = &component.plane[static_cast<size_t>(y0) * stride];
+    const uint8_t* row1 = &component.plane[static_cast<size_t>(y1) * stride];
+    for (int x = 0; x < width; x++) {
+        int sx = ((2 * x + 1) * 16 / fx - 16) / 2;
+        int x0 = std::max(0, sx >> 4), x1 = std::min(component.width - 1, (sx >> 4) + 1);
+        int wx = sx < 0 ? 0 : sx & 15;
+        int top = row0[x0] * (16 - wx) + row0[x1] * wx;
+        int bottom = row1[x0] * (16 - wx) + row1[x1] * wx;
+        out[x] = static_cast<uint8_t>((top * (16 - wy) + bottom * wy + 128) >> 8);
+    }
+}
+
+}
+
+bool LeanImageBackend::DecodeJPEG(const std::vector<unsigned char>& file, int channels, Image& image)
+{
+    Decoder jpeg{ file.data(), file.size() };
+
+    // == Markers ==
+    bool has_frame = false;
+    while (jpeg.pos + 4 <= jpeg.size) {
+        if (jpeg.data[jpeg.pos] != 0xFF) { jpeg.pos++; continue; } // Garbage between segments
+        int marker = jpeg.data[jpeg.pos + 1];
+        jpeg.pos += 2;
+        if (marker == 0xFF || marker == 0x00 || (marker >= 0xD0 && marker <= 0xD8)) { // Fill bytes, stuffing, RSTn, SOI
+            if (marker == 0xFF) jpeg.pos--;
+            continue;
+        }
+        if (marker == 0xD9) break; // EOI
+        if (marker == 0xDA) {
+            if (!has_frame || !jpeg.ReadScan()) return false;
+            continue;
+        }
+        int len = jpeg.data[jpeg.pos] << 8 | jpeg.data[jpeg.pos + 1];
+        if (len < 2 || jpeg.pos + len > jpeg.size) return false;
+        const unsigned char* segment = &jpeg.data[jpeg.pos + 2];
+        size_t segment_len = len - 2;
+        switch (marker) {
+        case 0xC0: // Baseline
+        case 0xC1: // Extended sequential, Huffman
+        case 0xC2: // Progressive, Huffman
+            if (has_frame || !jpeg.ReadFrame(segment, segment_len, marker == 0xC2)) return false;
+            has_frame = true;
+            break;
+        case 0xC4:
+            if (!jpeg.ReadHuffman(segment, segment_len)) return false;
+            break;
+        case 0xDB:
+            if (!jpeg.ReadQuant(segment, segment_len)) return false;
+            break;
+        case 0xDD:
+            if (segment_len >= 2) jpeg.restart_interval = segment[0] << 8 | segment[1];
+            break;
+        default:
+            if ((marker >= 0xC3 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) return false; // Lossless, hierarchical, arithmetic
+            break; // APPn, COM, ...
+        }
+        jpeg.pos += len;
+    }
+    if (!has_frame) return false;
+    jpeg.Finish();
+
+    // == Upsample, convert ==
+    bool is_gray_file = jpeg.n_components == 1;
+    int out_channels = channels == IMAGE_CHANNELS_ANY ? (is_gray_file ? 1 : 4) : channels;
+    image.width = jpeg.width;
+    image.height = jpeg.height;
+    image.channels = out_channels;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * out_channels);
+
+    int n_used = out_channels == 1 ? 1 : jpeg.n_components; // Gray output is Y
+    std::vector<uint8_t> upsampled[3];
+    for (int y = 0; y < jpeg.height; y++) {
+        const uint8_t* rows[3];
+        for (int c = 0; c < n_used; c++) {
+            const Component& component = jpeg.components[c];
+            if (component.h == jpeg.h_max && component.v == jpeg.v_max) {
+                rows[c] = &component.plane[static_cast<size_t>(y) * component.blocks_w * 8];
+            }
+            else {
+                upsampled[c].resize(jpeg.width);
+                UpsampleRow(component, jpeg.h_max, jpeg.v_max, y, jpeg.width, upsampled[c].data());
+                rows[c] = upsampled[c].data();
+            }
+        }
+        if (out_channels == 1) std::memcpy(image.Row(y), rows[0], jpeg.width);
+        else if (is_gray_file) GrayToRGBA(rows[0], image.Row(y), jpeg.width);
+        else YCbCrToRGBA(rows[0], rows[1], rows[2], image.Row(y), jpeg.width);
+    }
+    print("DecodeJPEG: " << jpeg.width << "x" << jpeg.height << (jpeg.is_progressive ? ", progressive" : ", baseline") << ", " << jpeg.n_components << " components");
+    return true;
+}
@@ -0,0 +1,531 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "LeanImageBackend.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+//
+// https://www.w3.org/TR/png/ and RFC 1950, 1951 (zlib, deflate)
+//
+
+namespace {
+
+// Deflate reads bits from the least significant one
+struct BitReader {
+    const unsigned char* data;
+    size_t size;
+    size_t pos = 0;
+    uint64_t bits = 0;
+    int count = 0;
+
+    void Refill()
+    {
+        while (count <= 56) {
+            uint64_t byte = pos < size ? data[pos] : 0; // Zeros past the end, IsPastEnd() tells
+            pos++;
+            bits |= byte << count;
+            count += 8;
+        }
+    }
+    unsigned Peek(int n) { if (count < n) Refill(); return static_cast<unsigned>(bits & ((1ull << n) - 1)); }
+    void Consume(int n) { bits >>= n; count -= n; }
+    unsigned Read(int n) { unsigned value = Peek(n); Consume(n); return value; }
+    void AlignToByte() { Consume(count % 8); }
+    bool IsPastEnd() const { return pos - count / 8 > size; }
+};
+
+// Canonical Huffman code; table is indexed by the next max_len bits (codes are stored bit reversed)
+struct Huffman {
+    std::vector<uint16_t> table; // symbol | length << 9, length 0 = invalid code
+    int max_len = 0;
+
+    bool Build(const unsigned char* lengths, int n)
+    {
+        int counts[16]{};
+        for (int i = 0; i < n; i++) counts[lengths[i]]++;
+        counts[0] = 0;
+        max_len = 1;
+        for (int len = 1; len < 16; len++) {
+            if (counts[len]) max_len = len;
+        }
+        int next_code[16]{};
+        int code = 0;
+        for (int len = 1; len < 16; len++) {
+            code = (code + counts[len - 1]) << 1;
+            next_code[len] = code;
+            if (code + counts[len] > (1 << len)) return false; // Oversubscribed
+        }
+        table.assign(static_cast<size_t>(1) << max_len, 0);
+        for (int symbol = 0; symbol < n; symbol++) {
+            int len = lengths[symbol];
+            if (!len) continue;
+            int reversed = 0;
+            for (int i = 0, c = next_code[len]++; i < len; i++, c >>= 1) {
+                reversed = (reversed << 1) | (c & 1);
+            }
+            for (size_t i = reversed; i < table.size(); i += static_cast<size_t>(1) << len) {
+                table[i] = static_cast<uint16_t>(symbol | len << 9);
+            }
+        }
+        return true;
+    }
+
+    int Decode(BitReader& reader) const
+    {
+        unsigned entry = table[reader.Peek(max_len)];
+        int len = entry >> 9;
+        if (!len) return -1;
+        reader.Consume(len);
+        return entry & 511;
+    }
+};
+
+const int length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+uint32_t ReadBE32(const unsigned char* p)
+{
+    return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Deflate writes bits from the least significant one too, Huffman codes from their most significant bit
+struct BitWriter {
+    std::vector<unsigned char>& out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    void Write(unsigned value, int n)
+    {
+        bits |= static_cast<uint64_t>(value) << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(static_cast<unsigned char>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    void WriteCode(unsigned code, int n)
+    {
+        unsigned reversed = 0;
+        for (int i = 0; i < n; i++, code >>= 1) reversed = (reversed << 1) | (code & 1);
+        Write(reversed, n);
+    }
+    void Flush() { if (count) Write(0, 8 - count); }
+};
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+void WriteLiteral(BitWriter& writer, int symbol)
+{
+    if (symbol < 144) writer.WriteCode(0x30 + symbol, 8);
+    else if (symbol < 256) writer.WriteCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280) writer.WriteCode(symbol - 256, 7);
+    else writer.WriteCode(0xC0 + symbol - 280, 8);
+}
+
+void WriteBE32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+uint32_t Crc32(const unsigned char* data, size_t size)
+{
+    static const auto table = []() {
+        std::vector<uint32_t> crcs(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crcs[n] = c;
+        }
+        return crcs;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+int Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+}
+
+bool LeanImageBackend::Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    // zlib header: deflate, no preset dictionary
+    if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) return false;
+    BitReader reader{ data + 2, size - 2 };
+    size_t written = 0;
+
+    Huffman literals, distances;
+    bool is_final = false;
+    while (!is_final) {
+        is_final = reader.Read(1);
+        unsigned type = reader.Read(2);
+        if (type == 0) {
+            // Stored
+            reader.AlignToByte();
+            unsigned len = reader.Read(16);
+            unsigned nlen = reader.Read(16);
+            if ((len ^ 0xFFFF) != nlen || written + len > out.size()) return false;
+            for (unsigned i = 0; i < len; i++) {
+                out[written++] = static_cast<unsigned char>(reader.Read(8));
+            }
+            if (reader.IsPastEnd()) return false;
+            continue;
+        }
+
+        unsigned char lengths[288 + 32];
+        if (type == 1) {
+            // Fixed codes
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            std::fill(lengths + 288, lengths + 320, 5);
+            literals.Build(lengths, 288);
+            distances.Build(lengths + 288, 32);
+        }
+        else if (type == 2) {
+            // Dynamic codes, their lengths are Huffman coded too
+            static const int order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            int n_literals = reader.Read(5) + 257;
+            int n_distances = reader.Read(5) + 1;
+            int n_code_lengths = reader.Read(4) + 4;
+            unsigned char code_lengths[19]{};
+            for (int i = 0; i < n_code_lengths; i++) {
+                code_lengths[order[i]] = static_cast<unsigned char>(reader.Read(3));
+            }
+            Huffman code_length_code;
+            if (!code_length_code.Build(code_lengths, 19)) return false;
+            int n = 0;
+            while (n < n_literals + n_distances) {
+                int symbol = code_length_code.Decode(reader);
+                if (symbol < 0) return false;
+                if (symbol < 16) {
+                    lengths[n++] = static_cast<unsigned char>(symbol);
+                    continue;
+                }
+                int repeat;
+                unsigned char value = 0;
+                if (symbol == 16) {
+                    if (n == 0) return false;
+                    value = lengths[n - 1];
+                    repeat = 3 + reader.Read(2);
+                }
+                else if (symbol == 17) repeat = 3 + reader.Read(3);
+                else repeat = 11 + reader.Read(7);
+                if (n + repeat > n_literals + n_distances) return false;
+                std::fill(lengths + n, lengths + n + repeat, value);
+                n += repeat;
+            }
+            if (!literals.Build(lengths, n_literals) || !distances.Build(lengths + n_literals, n_distances)) return false;
+        }
+        else {
+            return false;
+        }
+
+        while (true) {
+            int symbol = literals.Decode(reader);
+            if (symbol < 0 || reader.IsPastEnd()) return false;
+            if (symbol < 256) {
+                if (written == out.size()) return false;
+                out[written++] = static_cast<unsigned char>(symbol);
+                continue;
+            }
+            if (symbol == 256) break;
+            symbol -= 257;
+            if (symbol >= 29) return false;
+            size_t len = length_base[symbol] + reader.Read(length_extra[symbol]);
+            int distance_symbol = distances.Decode(reader);
+            if (distance_symbol < 0 || distance_symbol >= 30) return false;
+            size_t distance = distance_base[distance_symbol] + reader.Read(distance_extra[distance_symbol]);
+            if (distance > written || written + len > out.size()) return false;
+            // Byte by byte, source and destination may overlap
+            unsigned char* dst = &out[written];
+            const unsigned char* src = dst - distance;
+            for (size_t i = 0; i < len; i++) dst[i] = src[i];
+            written += len;
+        }
+    }
+    return written == out.size();
+}
+
+void LeanImageBackend::Deflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    const size_t window = 32768, min_match = 3, max_match = 258;
+    const int hash_bits = 15;
+
+    out.push_back(0x78); // zlib header: deflate, 32K window, fastest
+    out.push_back(0x01);
+    BitWriter writer{ out };
+    writer.Write(1, 1); // One final block
+    writer.Write(1, 2); // Fixed codes
+
+    // Greedy LZ77, one candidate per hash of the next 3 bytes (good enough for rendered images with flat areas)
+    std::vector<int64_t> last(static_cast<size_t>(1) << hash_bits, -1);
+    auto hash = [data](size_t i) { return ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - hash_bits); };
+    size_t i = 0;
+    while (i < size) {
+        size_t len = 0, distance = 0;
+        if (i + min_match <= size) {
+            uint32_t h = hash(i);
+            int64_t candidate = last[h];
+            last[h] = static_cast<int64_t>(i);
+            if (candidate >= 0 && i - candidate <= window) {
+                size_t limit = std::min(max_match, size - i);
+                while (len < limit && data[candidate + len] == data[i + len]) len++;
+                distance = i - candidate;
+            }
+        }
+        if (len < min_match) {
+            WriteLiteral(writer, data[i++]);
+            continue;
+        }
+
+        int length_code = static_cast<int>(std::upper_bound(length_base, length_base + 29, static_cast<int>(len)) - length_base) - 1;
+        WriteLiteral(writer, 257 + length_code);
+        writer.Write(static_cast<unsigned>(len - length_base[length_code]), length_extra[length_code]);
+        int distance_code = static_cast<int>(std::upper_bound(distance_base, distance_base + 30, static_cast<int>(distance)) - distance_base) - 1;
+        writer.WriteCode(distance_code, 5);
+        writer.Write(static_cast<unsigned>(distance - distance_base[distance_code]), distance_extra[distance_code]);
+
+        // Positions inside the match are hashed too, long runs keep finding themselves
+        for (size_t j = i + 1; j < i + len && j + min_match <= size; j++) last[hash(j)] = static_cast<int64_t>(j);
+        i += len;
+    }
+    WriteLiteral(writer, 256);
+    writer.Flush();
+
+    uint32_t a = 1, b = 0; // Adler-32
+    for (size_t j = 0; j < size; j++) {
+        a = (a + data[j]) % 65521;
+        b = (b + a) % 65521;
+    }
+    WriteBE32(out, b << 16 | a);
+}
+
+std::vector<unsigned char> LeanImageBackend::EncodePNG(const Image& image)
+{
+    // Up filter on every row, neighbouring rows of a render are alike
+    size_t stride = static_cast<size_t>(image.width) * image.channels;
+    std::vector<unsigned char> raw(image.height * (stride + 1));
+    for (int y = 0; y < image.height; y++) {
+        unsigned char* row = &raw[y * (stride + 1)];
+        const unsigned char* pixels = image.Row(y);
+        const unsigned char* prior = y ? image.Row(y - 1) : nullptr;
+        row[0] = 2;
+        for (size_t x = 0; x < stride; x++) row[1 + x] = static_cast<unsigned char>(pixels[x] - (prior ? prior[x] : 0));
+    }
+
+    std::vector<unsigned char> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    auto chunk = [&file](const char* type, const std::vector<unsigned char>& data) {
+        WriteBE32(file, static_cast<uint32_t>(data.size()));
+        size_t start = file.size();
+        file.insert(file.end(), type, type + 4);
+        file.insert(file.end(), data.begin(), data.end());
+        WriteBE32(file, Crc32(&file[start], file.size() - start));
+    };
+    std::vector<unsigned char> header;
+    WriteBE32(header, image.width);
+    WriteBE32(header, image.height);
+    header.insert(header.end(), { 8, static_cast<unsigned char>(image.channels == 1 ? 0 : 6), 0, 0, 0 }); // 8-bit gray or RGBA
+    chunk("IHDR", header);
+    std::vector<unsigned char> compressed;
+    Deflate(raw.data(), raw.size(), compressed);
+    chunk("IDAT", compressed);
+    chunk("IEND", {});
+    return file;
+}
+
+bool LeanImageBackend::DecodePNG(const std::vector<unsigned char>& file, int channels, Image& image)
+{
+    // == Chunks ==
+    uint32_t width = 0, height = 0;
+    int depth = 0, color_type = -1;
+    unsigned char palette[256][4]{}; // RGBA
+    bool has_key = false;
+    unsigned key[3]{};               // tRNS of gray and RGB images: this color is transparent
+    std::vector<unsigned char> compressed;
+    size_t pos = 8;
+    while (pos + 12 <= file.size()) {
+        uint32_t len = ReadBE32(&file[pos]);
+        const unsigned char* type = &file[pos + 4];
+        const unsigned char* data = &file[pos + 8];
+        if (len > file.size() - pos - 12) return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (len < 13) return false;
+            width = ReadBE32(data);
+            height = ReadBE32(data + 4);
+            depth = data[8];
+            color_type = data[9];
+            if (data[10] != 0 || data[11] != 0) return false;
+            if (data[12] != 0) return false; // Interlaced, left to other backends
+        }
+        else if (std::memcmp(type, "PLTE", 4) == 0) {
+            for (uint32_t i = 0; i < len / 3 && i < 256; i++) {
+                palette[i][0] = data[i * 3];
+                palette[i][1] = data[i * 3 + 1];
+                palette[i][2] = data[i * 3 + 2];
+                palette[i][3] = 255;
+            }
+        }
+        else if (std::memcmp(type, "tRNS", 4) == 0) {
+            if (color_type == 3) {
+                for (uint32_t i = 0; i < len && i < 256; i++) palette[i][3] = data[i];
+            }
+            else if (color_type == 0 && len >= 2) {
+                has_key = true;
+                key[0] = data[0] << 8 | data[1];
+            }
+            else if (color_type == 2 && len >= 6) {
+                has_key = true;
+                for (int i = 0; i < 3; i++) key[i] = data[i * 2] << 8 | data[i * 2 + 1];
+            }
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), data, data + len);
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + len;
+    }
+
+    int samples;
+    switch (color_type) {
+    case 0: samples = 1; break; // Gray
+    case 2: samples = 3; break; // RGB
+    case 3: samples = 1; break; // Palette
+    case 4: samples = 2; break; // Gray, alpha
+    case 6: samples = 4; break; // RGBA
+    default: return false;
+    }
+    bool is_depth_valid = depth == 8 || depth == 16 || ((color_type == 0 || color_type == 3) && (depth == 1 || depth == 2 || depth == 4));
+    if (!is_depth_valid || width == 0 || height == 0 || width > (1 << 16) || height > (1 << 16)) return false;
+
+    // == Decompress, unfilter ==
+    size_t bits_per_pixel = static_cast<size_t>(samples) * depth;
+    size_t stride = (width * bits_per_pixel + 7) / 8;
+    size_t filter_bpp = std::max<size_t>(1, bits_per_pixel / 8); // Bytes to the corresponding byte of the previous pixel
+    std::vector<unsigned char> raw(height * (stride + 1));
+    if (!Inflate(compressed.data(), compressed.size(), raw)) return false;
+    compressed = std::vector<unsigned char>();
+
+    std::vector<unsigned char> zeros(stride, 0);
+    for (uint32_t y = 0; y < height; y++) {
+        unsigned char filter = raw[y * (stride + 1)];
+        unsigned char* row = &raw[y * (stride + 1) + 1];
+        const unsigned char* prior = y ? &raw[(y - 1) * (stride + 1) + 1] : zeros.data();
+        switch (filter) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = filter_bpp; i < stride; i++) row[i] += row[i - filter_bpp];
+            break;
+        case 2:
+            for (size_t i = 0; i < stride; i++) row[i] += prior[i];
+            break;
+        case 3:
+            for (size_t i = 0; i < filter_bpp; i++) row[i] += prior[i] / 2;
+            for (size_t i = filter_bpp; i < stride; i++) row[i] += (row[i - filter_bpp] + prior[i]) / 2;
+            break;
+        case 4:
+            for (size_t i = 0; i < filter_bpp; i++) row[i] += prior[i];
+            for (size_t i = filter_bpp; i < stride; i++) row[i] += static_cast<unsigned char>(Paeth(row[i - filter_bpp], prior[i], prior[i - filter_bpp]));
+            break;
+        default:
+            return false;
+        }
+    }
+
+    // == Convert to gray or RGBA ==
+    bool is_gray_file = color_type == 0 || color_type == 4;
+    int out_channels = channels;
+    if (channels == IMAGE_CHANNELS_ANY) out_channels = color_type == 0 && !has_key ? 1 : 4;
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    image.channels = out_channels;
+    image.pixels.resize(static_cast<size_t>(width) * height * out_channels);
+
+    std::vector<unsigned char> samples8(static_cast<size_t>(width) * samples); // 8 bits per sample
+    std::vector<unsigned char> rgba(out_channels == 1 && !is_gray_file ? width * 4 : 0);
+    int scale = depth < 8 ? 255 / ((1 << depth) - 1) : 1; // Low bit depth gray to 0..255 (not palette indices)
+    for (uint32_t y = 0; y < height; y++) {
+        const unsigned char* row = &raw[y * (stride + 1) + 1];
+        unsigned char* out = image.Row(y);
+
+        const unsigned char* s = row;
+        if (depth == 16) {
+            for (size_t i = 0; i < samples8.size(); i++) samples8[i] = row[i * 2];
+            s = samples8.data();
+        }
+        else if (depth < 8) {
+            for (uint32_t x = 0; x < width; x++) {
+                int bit = x * depth;
+                unsigned value = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+                samples8[x] = static_cast<unsigned char>(color_type == 3 ? value : value * scale);
+            }
+            s = samples8.data();
+        }
+
+        // Color key transparency compares the samples as stored
+        auto is_key = [&](uint32_t x) {
+            if (!has_key) return false;
+            auto sample = [&](int i) -> unsigned {
+                size_t index = static_cast<size_t>(x) * samples + i;
+                if (depth == 16) return row[index * 2] << 8 | row[index * 2 + 1];
+                if (depth == 8) return row[index];
+                return s[index] / scale;
+            };
+            for (int i = 0; i < samples; i++) {
+                if (sample(i) != key[i]) return false;
+            }
+            return true;
+        };
+
+        unsigned char* dst = out_channels == 4 ? out : rgba.data();
+        switch (color_type) {
+        case 0:
+            if (out_channels == 1) { std::memcpy(out, s, width); break; }
+            GrayToRGBA(s, dst, width);
+            break;
+        case 2:
+            ExpandRGB(s, dst, width);
+            break;
+        case 3:
+            for (uint32_t x = 0; x < width; x++) std::memcpy(dst + x * 4, palette[s[x]], 4);
+            break;
+        case 4:
+            for (uint32_t x = 0; x < width; x++) {
+                if (out_channels == 1) { out[x] = s[x * 2]; continue; }
+                dst[x * 4] = dst[x * 4 + 1] = dst[x * 4 + 2] = s[x * 2];
+                dst[x * 4 + 3] = s[x * 2 + 1];
+            }
+            break;
+        case 6:
+            std::memcpy(dst, s, static_cast<size_t>(width) * 4);
+            break;
+        }
+        if (out_channels == 4 && has_key) {
+            for (uint32_t x = 0; x < width; x++) {
+                if (is_key(x)) dst[x * 4 + 3] = 0;
+            }
+        }
+        if (out_channels == 1 && !is_gray_file) RGBAToGray(rgba.data(), out, width);
+    }
+    print("DecodePNG: " << width << "x" << height << ", color type " << color_type << ", depth " << depth);
+    return true;
+}
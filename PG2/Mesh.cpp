@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "ShaderProgram.hpp"
@@ -5,54 +6,134 @@
 
 #define print(x) std::cout << x << "\n"
 
-Mesh::Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id) :
+Mesh::Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id, bool is_dynamic) :
     primitive_type(primitive_type),
     vertices(vertices),
     indices(indices),
-    texture_id(texture_id)
+    texture_id(texture_id),
+    is_dynamic(is_dynamic)
 {
-    // Create and initialize VAO, VBO, EBO and parameters
-    // Generate the VAO and VBO
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    // Bind VAO (set as the current)
-    glBindVertexArray(VAO);
-    // Bind the VBO, set type as GL_ARRAY_BUFFER
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // Fill-in data into the VBO
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-    // Bind EBO, set type GL_ELEMENT_ARRAY_BUFFER
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    // Fill-in data into the EBO
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    // Create and initialize VAO, VBO, EBO and parameters (DSA, nothing gets bound)
+    glCreateVertexArrays(1, &VAO);
+    CreateBuffers();
 
     // Set and enable the Vertex Attribute for position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(0 + offsetof(Vertex, position)));
-    glEnableVertexAttribArray(0);
+    glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+    glVertexArrayAttribBinding(VAO, 0, 0);
+    glEnableVertexArrayAttrib(VAO, 0);
     // Set end enable Vertex Attribute for Normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(0 + offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(1);
+    glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+    glVertexArrayAttribBinding(VAO, 1, 0);
+    glEnableVertexArrayAttrib(VAO, 1);
     // Set end enable Vertex Attribute for Texture Coordinates
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(0 + offsetof(Vertex, tex_coords)));
-    glEnableVertexAttribArray(2);
+    glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coords));
+    glVertexArrayAttribBinding(VAO, 2, 0);
+    glEnableVertexArrayAttrib(VAO, 2);
+};
+
+void Mesh::CreateBuffers()
+{
+    glCreateBuffers(1, &VBO);
+    glCreateBuffers(1, &EBO);
+
+    // Immutable storage; static meshes are never changed again
+    GLsizeiptr vertices_size = vertices.size() * sizeof(Vertex);
+    if (is_dynamic) {
+        // Persistent coherent mapping, writes are visible to GPU without flushing or remapping
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glNamedBufferStorage(VBO, vertices_size * MESH_DYNAMIC_REGIONS, nullptr, flags);
+        mapped_vertices = static_cast<Vertex*>(glMapNamedBufferRange(VBO, 0, vertices_size * MESH_DYNAMIC_REGIONS, flags));
+        if (!mapped_vertices)
+            throw std::exception("Mesh: failed to map dynamic vertex buffer\n");
+        std::copy(vertices.begin(), vertices.end(), mapped_vertices);
+    }
+    else {
+        glNamedBufferStorage(VBO, vertices_size, vertices.data(), 0);
+    }
+    glNamedBufferStorage(EBO, indices.size() * sizeof(GLuint), indices.data(), 0);
 
-    // Bind VBO and VAO to 0 to prevent unintended modification of VAO/VBO
+    // Attach buffers to the VAO (binding point 0)
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(VAO, EBO);
+}
+
+void Mesh::Evict()
+{
+    if (is_dynamic || !IsResident()) return; // Dynamic meshes are rewritten every frame, they stay
+
+    // Deleted buffers are freed once GPU finishes draws that still use them
+    glVertexArrayVertexBuffer(VAO, 0, 0, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(VAO, 0);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VBO = 0;
+    EBO = 0;
+}
+
+void Mesh::Restore()
+{
+    if (IsResident()) return;
+    CreateBuffers(); // VAO kept its attribute format
+}
+
+size_t Mesh::GetGPUBytes() const
+{
+    size_t vertices_size = vertices.size() * sizeof(Vertex);
+    return (is_dynamic ? vertices_size * MESH_DYNAMIC_REGIONS : vertices_size) + indices.size() * sizeof(GLuint);
+}
+
+void Mesh::UpdateVertices(const std::vector<Vertex>& new_vertices)
+{
+    if (!is_dynamic || new_vertices.size() != vertices.size())
+        throw std::exception("Mesh: UpdateVertices needs a dynamic mesh and the same vertex count\n");
+
+    // Draws issued so far used the current region, fence them and move on
+    region_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % MESH_DYNAMIC_REGIONS;
+
+    // Wait only if the GPU still reads the region from MESH_DYNAMIC_REGIONS frames ago (it practically never does)
+    if (region_fences[region]) {
+        GLenum result = glClientWaitSync(region_fences[region], 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(region_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+        glDeleteSync(region_fences[region]);
+        region_fences[region] = nullptr;
+    }
+
+    base_vertex = static_cast<GLint>(region * vertices.size());
+    std::copy(new_vertices.begin(), new_vertices.end(), mapped_vertices + base_vertex);
+}
+
+void Mesh::Draw(ShaderProgram& shader, const glm::mat4& mx_model, const glm::mat3& mx_normal, bool depth_only)
+{
+    if (!IsResident()) return; // Evicted, ResidencyManager restores it once the model is visible
+    if (texture_index != -1 && !depth_only) {
+        shader.SetUniform("u_texture_index", texture_index); // Texture is in TextureTable (or VIRTUAL_TEXTURE_INDEX), nothing to bind
+    }
+    shader.SetUniform("u_mx_model", mx_model);
+    if (!depth_only) shader.SetUniform("u_mx_normal", mx_normal);
+    glBindVertexArray(VAO);
+    glDrawElementsBaseVertex(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, base_vertex);
     glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-};
+}
 
-void Mesh::Draw(ShaderProgram& shader, glm::mat4 mx_model)
+void Mesh::Draw(ShaderProgram& shader, const glm::mat4& mx_model, const glm::mat3& mx_normal, const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets, bool depth_only)
 {
-    if (texture_id > 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        shader.SetUniform("u_material.textura", 0); // We're only using texturing unit no. 0
+    if (counts.empty() || !IsResident()) return;
+    if (texture_index != -1 && !depth_only) {
+        shader.SetUniform("u_texture_index", texture_index); // Texture is in TextureTable (or VIRTUAL_TEXTURE_INDEX), nothing to bind
     }
     shader.SetUniform("u_mx_model", mx_model);
+    if (!depth_only) shader.SetUniform("u_mx_normal", mx_normal);
     glBindVertexArray(VAO);
-    glDrawElements(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+    if (base_vertex) {
+        chunk_base_vertices.assign(counts.size(), base_vertex);
+        glMultiDrawElementsBaseVertex(primitive_type, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(counts.size()), chunk_base_vertices.data());
+    }
+    else {
+        glMultiDrawElements(primitive_type, counts.data(), GL_UNSIGNED_INT, offsets.data(), static_cast<GLsizei>(counts.size()));
+    }
     glBindVertexArray(0);
 }
 
@@ -63,9 +144,15 @@ void Mesh::Clear()
     primitive_type = GL_POINTS;
 
     // delete all allocations 
+    for (auto& fence : region_fences) {
+        if (fence) { glDeleteSync(fence); fence = nullptr; }
+    }
+    if (mapped_vertices) { glUnmapNamedBuffer(VBO); mapped_vertices = nullptr; }
     //glDeleteBuffers... //VBO a EBO
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    VBO = 0;
+    EBO = 0;
 
     //glDeleteVertexArrays... // VAO
     if (VAO) { glDeleteVertexArrays(1, &VAO); VAO = 0; }
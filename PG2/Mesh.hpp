@@ -7,21 +7,42 @@
 #include "ShaderProgram.hpp"
 #include "Vertex.hpp"
 
+#define MESH_DYNAMIC_REGIONS 3 // Dynamic meshes: vertex buffer is split into N regions, CPU writes one while GPU reads the others
+
 class Mesh {
 public:
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
-    GLuint texture_id{ 0 }; // texture id=0  means no texture
+    GLuint texture_id{ 0 }; // texture id=0  means no texture (or that it was moved to TextureTable)
+    int texture_index = -1; // index into TextureTable, set by TextureTable::Build(); VIRTUAL_TEXTURE_INDEX (-2) for the virtual texture
     GLenum primitive_type = GL_POINTS;
 
-    Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id);
-    void Draw(ShaderProgram& shader, glm::mat4 mx_model);
+    Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id, bool is_dynamic = false);
+    void UpdateVertices(const std::vector<Vertex>& new_vertices); // Dynamic mesh only; same vertex count, call at most once per frame
+    void Draw(ShaderProgram& shader, const glm::mat4& mx_model, const glm::mat3& mx_normal, bool depth_only);
+    void Draw(ShaderProgram& shader, const glm::mat4& mx_model, const glm::mat3& mx_normal, const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets, bool depth_only); // Draw only given index ranges
     void Clear();
 
+    // GPU memory (ResidencyManager): static meshes can drop their buffers and upload them again from vertices/indices
+    void Evict();
+    void Restore();
+    bool IsResident() const { return VBO != 0; }
+    bool IsDynamic() const { return is_dynamic; }
+    size_t GetGPUBytes() const;
+
     // Tell the compiler to do what it would have if we didn't define a ctor:
     Mesh() = default;
 private:
     // OpenGL buffer IDs
     // ID = 0 is reserved (i.e. uninitalized)
     unsigned int VAO{ 0 }, VBO{ 0 }, EBO{ 0 };
+    void CreateBuffers(); // VBO, EBO with vertices/indices, attached to the VAO
+
+    // Dynamic mesh: persistently mapped vertex buffer, triple buffered
+    bool is_dynamic = false;
+    Vertex* mapped_vertices = nullptr;
+    GLsync region_fences[MESH_DYNAMIC_REGIONS]{}; // Set when the region is left, GPU is done with it once signaled
+    int region = 0;                               // Region used by draws
+    GLint base_vertex = 0;                        // region * vertices.size()
+    std::vector<GLint> chunk_base_vertices;       // For glMultiDrawElementsBaseVertex
 };
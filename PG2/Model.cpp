@@ -3,6 +3,7 @@
 #include <string>
 
 #include "Model.hpp"
+#include "Profiler.hpp"
 #include "Texture.hpp"
 
 #define print(x) //std::cout << x << "\n"
@@ -26,8 +27,48 @@ Model::Model(std::string name, const std::filesystem::path& path_main, const std
     mesh = Mesh(GL_TRIANGLES, mesh_vertices, mesh_vertex_indices, texture_id);
 }
 
-void Model::Draw(ShaderProgram& shader)
+void Model::Draw(ShaderProgram& shader, bool depth_only)
 {
+    UpdateMatrices();
+    // Draw
+    if (chunks.empty()) {
+        mesh.Draw(shader, mx_model, mx_normal, depth_only);
+    }
+    else {
+        // Draw only chunks that survived culling
+        chunk_draw_counts.clear();
+        chunk_draw_offsets.clear();
+        for (const auto& chunk : chunks) {
+            if (chunk.is_visible) {
+                chunk_draw_counts.push_back(chunk.n_indices);
+                chunk_draw_offsets.push_back(reinterpret_cast<const void*>(chunk.first_index * sizeof(GLuint)));
+            }
+        }
+        mesh.Draw(shader, mx_model, mx_normal, chunk_draw_counts, chunk_draw_offsets, depth_only);
+    }
+}
+
+const glm::mat4& Model::GetModelMatrix()
+{
+    UpdateMatrices();
+    return mx_model;
+}
+
+const glm::mat3& Model::GetNormalMatrix()
+{
+    UpdateMatrices();
+    return mx_normal;
+}
+
+void Model::UpdateMatrices()
+{
+    // Static objects (table, heightmap, ...) are never rebuilt after the first frame
+    if (!is_mx_dirty && position == mx_position && scale == mx_scale && rotation == mx_rotation) return;
+    mx_position = position;
+    mx_scale = scale;
+    mx_rotation = rotation;
+    is_mx_dirty = false;
+
     // Einheitsmatrix
     mx_model = glm::identity<glm::mat4>();
     // Move object
@@ -35,17 +76,41 @@ void Model::Draw(ShaderProgram& shader)
     // Scale object (scale in all three dimensions must be the same in this "engine")
     mx_model = glm::scale(mx_model, glm::vec3(scale));
     // Initial rotation (should be set only once when creating the Model)
-    init_rotation_axes = glm::vec3(init_rotation.x, init_rotation.y, init_rotation.z);
-    mx_model = glm::rotate(mx_model, glm::radians(init_rotation.w), init_rotation_axes);
+    mx_model = glm::rotate(mx_model, glm::radians(init_rotation.w), glm::vec3(init_rotation));
     // Additional rotation
-    rotation_axes = glm::vec3(rotation.x, rotation.y, rotation.z);
-    mx_model = glm::rotate(mx_model, glm::radians(rotation.w), rotation_axes);
-    // Draw
-    mesh.Draw(shader, mx_model);
+    mx_model = glm::rotate(mx_model, glm::radians(rotation.w), glm::vec3(rotation));
+
+    // https://computergraphics.stackexchange.com/questions/1502/why-is-the-transposed-inverse-of-the-model-view-matrix-used-to-transform-the-nor
+    mx_normal = glm::inverseTranspose(glm::mat3(mx_model));
+}
+
+glm::vec4 Model::GetWorldBoundingSphere(const glm::mat4& mx, glm::vec4 local_bounds) const
+{
+    // Scale is uniform, so the sphere stays a sphere
+    glm::vec3 center = mx * glm::vec4(glm::vec3(local_bounds), 1.0f);
+    return glm::vec4(center, local_bounds.w * scale);
+}
+
+glm::vec4 Model::CalculateBounds(const std::vector<glm::vec3>& points) const
+{
+    if (points.empty()) return glm::vec4(0.0f);
+    glm::vec3 min = points[0];
+    glm::vec3 max = points[0];
+    for (const auto& point : points) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    glm::vec3 center = (min + max) / 2.0f;
+    float radius = 0.0f;
+    for (const auto& point : points) {
+        radius = std::max(radius, glm::distance(center, point));
+    }
+    return glm::vec4(center, radius);
 }
 
 void Model::LoadOBJFile(const std::filesystem::path& file_name)
 {
+    PROFILE_ZONE("Model::LoadOBJFile");
     mesh_vertices.clear();
     mesh_vertex_indices.clear();
 
@@ -179,6 +244,8 @@ void Model::LoadOBJFile(const std::filesystem::path& file_name)
         collision_aabb_min *= scale;
         collision_aabb_max *= scale;
     }
+    // - Bounding sphere for culling
+    bounds = CalculateBounds(vertices);
     print_loading("#");
 
     // RETARDED DRAW  2.0
@@ -218,17 +285,18 @@ void Model::LoadOBJFile(const std::filesystem::path& file_name)
 
 void Model::HeightMap_Load(const std::filesystem::path& file_name)
 {
+    PROFILE_ZONE("Model::HeightMap_Load");
     mesh_vertices.clear();
     mesh_vertex_indices.clear();
 
-    cv::Mat hmap = cv::imread(file_name.u8string(), cv::IMREAD_GRAYSCALE);
-    if (hmap.empty()) std::cerr << "HeightMap: [!] Height map empty? File: " << file_name << "\n";
+    Image hmap = ImageLoad(file_name, IMAGE_CHANNELS_GRAY);
+    if (hmap.IsEmpty()) std::cerr << "HeightMap: [!] Height map empty? File: " << file_name << "\n";
 
-    const unsigned int mesh_step_size = 10;
+    const unsigned int mesh_step_size = HEIGHTMAP_STEP;
 
-    print("HeightMap: heightmap size: " << hmap.size << ", channels: " << hmap.channels());
+    print("HeightMap: heightmap size: " << hmap.width << "x" << hmap.height << ", channels: " << hmap.channels);
 
-    if (hmap.channels() != 1) std::cerr << "HeightMap: [!] requested 1 channel, got: " << hmap.channels() << "\n";
+    if (hmap.channels != 1) std::cerr << "HeightMap: [!] requested 1 channel, got: " << hmap.channels << "\n";
 
     // Create heightmap mesh from TRIANGLES in XZ plane, Y is UP (right hand rule)
     //
@@ -248,23 +316,30 @@ void Model::HeightMap_Load(const std::filesystem::path& file_name)
     std::map<std::pair<unsigned int, unsigned int>, glm::vec3> normal_sums;
     std::pair<unsigned int, unsigned int> pair, pair0, pair1, pair2, pair3;
 
-    for (unsigned int x_coord = 0; x_coord < (hmap.cols - mesh_step_size); x_coord += mesh_step_size) {
-        for (unsigned int z_coord = 0; z_coord < (hmap.rows - mesh_step_size); z_coord += mesh_step_size) {
+    // Tiles are grouped into square chunks for culling, each chunk has its own continuous range of indices
+    const unsigned int chunk_size = mesh_step_size * HEIGHTMAP_CHUNK_TILES;
+    const unsigned int n_chunks_z = (hmap.height - mesh_step_size + chunk_size - 1) / chunk_size;
+    const unsigned int n_chunks = n_chunks_z * ((hmap.width - mesh_step_size + chunk_size - 1) / chunk_size);
+    std::vector<std::vector<GLuint>> chunk_indices(n_chunks);
+    std::vector<std::vector<glm::vec3>> chunk_points(n_chunks);
+
+    for (unsigned int x_coord = 0; x_coord < (hmap.width - mesh_step_size); x_coord += mesh_step_size) {
+        for (unsigned int z_coord = 0; z_coord < (hmap.height - mesh_step_size); z_coord += mesh_step_size) {
 			// Get The (X, Y, Z) Value For The Bottom Left Vertex = 0
-			glm::vec3 p0(x_coord, hmap.at<uchar>(cv::Point(x_coord, z_coord)), z_coord);
+			glm::vec3 p0(x_coord, hmap.At(x_coord, z_coord), z_coord);
 			// Get The (X, Y, Z) Value For The Bottom Right Vertex = 1
-			glm::vec3 p1(x_coord + mesh_step_size, hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord)), z_coord);
+			glm::vec3 p1(x_coord + mesh_step_size, hmap.At(x_coord + mesh_step_size, z_coord), z_coord);
 			// Get The (X, Y, Z) Value For The Top Right Vertex = 2
-			glm::vec3 p2(x_coord + mesh_step_size, hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord + mesh_step_size)), z_coord + mesh_step_size);
+			glm::vec3 p2(x_coord + mesh_step_size, hmap.At(x_coord + mesh_step_size, z_coord + mesh_step_size), z_coord + mesh_step_size);
 			// Get The (X, Y, Z) Value For The Top Left Vertex = 3
-			glm::vec3 p3(x_coord, hmap.at<uchar>(cv::Point(x_coord, z_coord + mesh_step_size)), z_coord + mesh_step_size);
+			glm::vec3 p3(x_coord, hmap.At(x_coord, z_coord + mesh_step_size), z_coord + mesh_step_size);
 
 			// Get max normalized height for tile, set texture accordingly
 			// Grayscale image returns 0..256, normalize to 0.0f..1.0f by dividing by 256 (255 ?)
-			float max_h = std::max(hmap.at<uchar>(cv::Point(x_coord, z_coord)) / 255.0f,
-				std::max(hmap.at<uchar>(cv::Point(x_coord, z_coord + mesh_step_size)) / 255.0f,
-					std::max(hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord + mesh_step_size)) / 255.0f,
-						hmap.at<uchar>(cv::Point(x_coord + mesh_step_size, z_coord)) / 255.0f
+			float max_h = std::max(hmap.At(x_coord, z_coord) / 255.0f,
+				std::max(hmap.At(x_coord, z_coord + mesh_step_size) / 255.0f,
+					std::max(hmap.At(x_coord + mesh_step_size, z_coord + mesh_step_size) / 255.0f,
+						hmap.At(x_coord + mesh_step_size, z_coord) / 255.0f
 					)));
 
             // Get texture coords in vertices, bottom left of geometry == bottom left of texture
@@ -285,14 +360,17 @@ void Model::HeightMap_Load(const std::filesystem::path& file_name)
             mesh_vertices.emplace_back(Vertex{ p2, -normal, tc2 });
             mesh_vertices.emplace_back(Vertex{ p3, -normal, tc3 });
 
-            // - place indices
+            // - place indices (to the chunk this tile belongs to)
+            unsigned int chunk_n = (x_coord / chunk_size) * n_chunks_z + (z_coord / chunk_size);
+            auto& tile_indices = chunk_indices[chunk_n];
             indices_counter += 4;
-            mesh_vertex_indices.emplace_back(indices_counter - 4);
-            mesh_vertex_indices.emplace_back(indices_counter - 2);
-            mesh_vertex_indices.emplace_back(indices_counter - 3);
-            mesh_vertex_indices.emplace_back(indices_counter - 4);
-            mesh_vertex_indices.emplace_back(indices_counter - 1);
-            mesh_vertex_indices.emplace_back(indices_counter - 2);
+            tile_indices.emplace_back(indices_counter - 4);
+            tile_indices.emplace_back(indices_counter - 2);
+            tile_indices.emplace_back(indices_counter - 3);
+            tile_indices.emplace_back(indices_counter - 4);
+            tile_indices.emplace_back(indices_counter - 1);
+            tile_indices.emplace_back(indices_counter - 2);
+            chunk_points[chunk_n].insert(chunk_points[chunk_n].end(), { p0, p1, p2, p3 });
 
             // - normal averaging
             pair0 = { x_coord, z_coord };
@@ -306,6 +384,18 @@ void Model::HeightMap_Load(const std::filesystem::path& file_name)
         }
     }
 
+    // - chunks
+    for (unsigned int chunk_n = 0; chunk_n < n_chunks; chunk_n++) {
+        if (chunk_indices[chunk_n].empty()) continue;
+        Chunk chunk{};
+        chunk.first_index = static_cast<GLsizei>(mesh_vertex_indices.size());
+        chunk.n_indices = static_cast<GLsizei>(chunk_indices[chunk_n].size());
+        chunk.bounds = CalculateBounds(chunk_points[chunk_n]);
+        chunk.is_visible = true;
+        chunks.push_back(chunk);
+        mesh_vertex_indices.insert(mesh_vertex_indices.end(), chunk_indices[chunk_n].begin(), chunk_indices[chunk_n].end());
+    }
+
     // - normal averaging, 2nd iter
     for (auto& vertex : mesh_vertices) {
         pair = { static_cast<unsigned int>(vertex.position.x), static_cast<unsigned int>(vertex.position.z) };
@@ -314,7 +404,14 @@ void Model::HeightMap_Load(const std::filesystem::path& file_name)
         _heights[{vertex.position.x * HEGHTMAP_SCALE, vertex.position.z * HEGHTMAP_SCALE}] = vertex.position.y; // for heightmap collision
     }
 
-    print("HeightMap: height map vertices: " << mesh_vertices.size());
+    // - bounding sphere of the whole heightmap
+    std::vector<glm::vec3> points;
+    for (const auto& vertex : mesh_vertices) {
+        points.push_back(vertex.position);
+    }
+    bounds = CalculateBounds(points);
+
+    print("HeightMap: height map vertices: " << mesh_vertices.size() << ", chunks: " << chunks.size());
 }
 
 glm::vec2 Model::HeightMap_GetSubtexST(const int x, const int y)
@@ -353,4 +450,5 @@ bool Model::Collision_CheckPoint(glm::vec3 point) const
 void Model::Clear()
 {
     mesh.Clear();
+    if (occlusion_query) { glDeleteQueries(1, &occlusion_query); occlusion_query = 0; }
 }
@@ -8,6 +8,8 @@
 #include "ShaderProgram.hpp"
 
 #define HEGHTMAP_SCALE 0.1f
+#define HEIGHTMAP_CHUNK_TILES 16 // Heightmap is split into chunks of N*N tiles, that are culled separately
+#define HEIGHTMAP_STEP 10        // Heightmap pixels per tile (one quad of the mesh)
 
 class Model
 {
@@ -15,16 +17,42 @@ public:
     std::string name;
 
     Model(std::string name, const std::filesystem::path& path_main, const std::filesystem::path& path_tex, glm::vec3 position, float scale, glm::vec4 init_rotation, bool is_height_map, bool use_aabb);
-    void Draw(ShaderProgram& shader);
+    void Draw(ShaderProgram& shader, bool depth_only = false); // depth_only: set only u_mx_model (depth pre-pass)
     void Clear();
+    Mesh& GetMesh() { return mesh; }
     
     // Transformations
     glm::vec3 position{};    
     float scale{};
     glm::vec4 rotation = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f); // axes xyz + angle (deg)
+    const glm::mat4& GetModelMatrix();  // Object local coor space -> World space; cached, rebuilt only if transformations changed
+    const glm::mat3& GetNormalMatrix(); // transpose(inverse(model matrix)) for normals; cached the same way
+
+    // Culling
+    glm::vec4 bounds{}; // Bounding sphere in model space: xyz center + w radius
+    glm::vec4 world_bounds{}; // Bounding sphere in world space, updated every frame by culling
+    bool is_visible = true;
+    struct Chunk {      // Part of the mesh that can be culled separately (heightmap)
+        GLsizei first_index;
+        GLsizei n_indices;
+        glm::vec4 bounds;
+        bool is_visible;
+    };
+    std::vector<Chunk> chunks;
+    // - Occlusion (OcclusionCuller)
+    GLuint occlusion_query{ 0 };
+    bool is_occlusion_queried = false; // Query was issued this frame, model is drawn conditionally
+    bool is_occluded = false;          // Last available query result
+    glm::vec4 GetWorldBoundingSphere(const glm::mat4& mx, glm::vec4 local_bounds) const; // Model space bounding sphere -> World space (mx = model matrix)
+    // - Occluder geometry (SoftwareOcclusionCuller), not changed after loading
+    const std::vector<Vertex>& GetMeshVertices() const { return mesh_vertices; }
+    const std::vector<GLuint>& GetMeshIndices() const { return mesh_vertex_indices; }
+    // - Heightmap tiles: texture coords of the subtexture in the tilemap (also used to bake VirtualTexture)
+    static glm::vec2 HeightMap_GetSubtexST(const int x, const int y);
+    static glm::vec2 HeightMap_GetSubtexByHeight(float height); // max. height of the tile, 0..1
 
     //
-    float _distance_from_camera; // for sorting transparent objects
+    size_t _draw_list_index{}; // position in DepthSortedList
     std::map<std::pair<float, float>, float> _heights; // for heightmap collision
 
     // Collision
@@ -42,10 +70,20 @@ private:
     std::vector<Vertex> mesh_vertices{};
     std::vector<GLuint> mesh_vertex_indices{};
 
-    // For storing values in Draw()
+    // Cached matrices and transformations they were built from (model is dirty if any of them differs)
     glm::mat4 mx_model{};
-    glm::vec3 rotation_axes{};
-    glm::vec3 init_rotation_axes{};
+    glm::mat3 mx_normal{};
+    glm::vec3 mx_position{};
+    float mx_scale{};
+    glm::vec4 mx_rotation{};
+    bool is_mx_dirty = true;
+    void UpdateMatrices();
+
+    // For storing values in Draw()
+    std::vector<GLsizei> chunk_draw_counts;
+    std::vector<const void*> chunk_draw_offsets;
+
+    glm::vec4 CalculateBounds(const std::vector<glm::vec3>& points) const; // Bounding sphere around points
 
     // Transformations
     glm::vec4 init_rotation{}; // axes xyz + angle (deg); if model is weirdly rotated, it can be fixed with this rotation and other rotations are relative to this
@@ -55,6 +93,4 @@ private:
 
     // HeightMap
     void HeightMap_Load(const std::filesystem::path& file_name);
-    glm::vec2 HeightMap_GetSubtexST(const int x, const int y);
-    glm::vec2 HeightMap_GetSubtexByHeight(float height);
 };
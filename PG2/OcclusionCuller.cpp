@@ -0,0 +1,127 @@
+#include <iostream>
+
+#include <glm/ext.hpp>
+
+#include "OcclusionCuller.hpp"
+#include "Model.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+#define OCCLUSION_CAMERA_MARGIN 0.2f // Bounding box this close to camera could be clipped by near plane, such model is always drawn
+
+void OcclusionCuller::Init()
+{
+    const glm::vec3 vertices[] = {
+        { -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+        { -1.0f, -1.0f,  1.0f }, { 1.0f, -1.0f,  1.0f }, { 1.0f, 1.0f,  1.0f }, { -1.0f, 1.0f,  1.0f }
+    };
+    const GLuint indices[] = {
+        0, 2, 1, 0, 3, 2, // back
+        4, 5, 6, 4, 6, 7, // front
+        0, 1, 5, 0, 5, 4, // bottom
+        3, 6, 2, 3, 7, 6, // top
+        0, 4, 7, 0, 7, 3, // left
+        1, 2, 6, 1, 6, 5  // right
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void OcclusionCuller::Clear()
+{
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    if (VAO) { glDeleteVertexArrays(1, &VAO); VAO = 0; }
+}
+
+void OcclusionCuller::BeginFrame()
+{
+    occluded_count = 0;
+}
+
+void OcclusionCuller::BeginQueries(ShaderProgram& depth_shader, const glm::mat4& mx_view_projection, glm::vec3 camera_position)
+{
+    this->depth_shader = &depth_shader;
+    this->camera_position = camera_position;
+
+    // Boxes only test the depth buffer, they must not change it
+    glGetBooleanv(GL_COLOR_WRITEMASK, color_mask);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+    is_cull_face_on = glIsEnabled(GL_CULL_FACE);
+    depth_shader.Activate();
+    depth_shader.SetUniform("u_mx_view_projection", mx_view_projection);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+    glBindVertexArray(VAO);
+}
+
+void OcclusionCuller::Query(Model* model)
+{
+    if (!model->occlusion_query) {
+        glGenQueries(1, &model->occlusion_query);
+    }
+
+    // Result of the previous query, only if we don't have to wait for it
+    if (model->is_occlusion_queried) {
+        GLuint is_available = GL_FALSE;
+        glGetQueryObjectuiv(model->occlusion_query, GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if (is_available) {
+            GLuint any_samples_passed = GL_TRUE;
+            glGetQueryObjectuiv(model->occlusion_query, GL_QUERY_RESULT, &any_samples_passed);
+            model->is_occluded = !any_samples_passed;
+        }
+    }
+
+    // Axis aligned box around bounding sphere
+    glm::vec3 center(model->world_bounds);
+    float radius = model->world_bounds.w;
+    glm::vec3 to_camera = glm::abs(camera_position - center);
+    if (to_camera.x < radius + OCCLUSION_CAMERA_MARGIN && to_camera.y < radius + OCCLUSION_CAMERA_MARGIN && to_camera.z < radius + OCCLUSION_CAMERA_MARGIN) {
+        model->is_occlusion_queried = false;
+        model->is_occluded = false;
+        return;
+    }
+
+    glm::mat4 mx_box = glm::scale(glm::translate(glm::identity<glm::mat4>(), center), glm::vec3(radius));
+    depth_shader->SetUniform("u_mx_model", mx_box);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, model->occlusion_query);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+    model->is_occlusion_queried = true;
+
+    if (model->is_occluded) occluded_count++;
+}
+
+void OcclusionCuller::EndQueries()
+{
+    glBindVertexArray(0);
+    glColorMask(color_mask[0], color_mask[1], color_mask[2], color_mask[3]);
+    glDepthMask(depth_mask);
+    if (is_cull_face_on) glEnable(GL_CULL_FACE);
+    print("OcclusionCuller: occluded " << occluded_count);
+}
+
+void OcclusionCuller::Draw(Model* model, ShaderProgram& shader, bool depth_only)
+{
+    if (!model->is_occlusion_queried) {
+        model->Draw(shader, depth_only);
+        return;
+    }
+    // GPU decides, if the result isn't ready yet the model is drawn
+    glBeginConditionalRender(model->occlusion_query, GL_QUERY_NO_WAIT);
+    model->Draw(shader, depth_only);
+    glEndConditionalRender();
+}
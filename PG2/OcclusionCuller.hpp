@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.hpp"
+
+class Model;
+
+// Hardware occlusion culling
+// - bounding boxes are drawn with GL_ANY_SAMPLES_PASSED_CONSERVATIVE queries after the occluders (heightmap)
+// - models are then drawn with conditional rendering, so GPU skips them if no sample passed and CPU never waits
+// - results are read back only when already available (usually in the next frame) for statistics
+class OcclusionCuller
+{
+public:
+    void Init(); // Valid GL context must exist
+    void Clear();
+
+    void BeginFrame(); // Reset statistics
+    void BeginQueries(ShaderProgram& depth_shader, const glm::mat4& mx_view_projection, glm::vec3 camera_position);
+    void Query(Model* model); // Draw model's bounding box inside its query
+    void EndQueries();        // Restore GL state, activate your shader again after this
+    void Draw(Model* model, ShaderProgram& shader, bool depth_only); // Draw model only if its bounding box was visible
+
+    int GetOccludedCount() const { return occluded_count; }
+private:
+    // Unit cube <-1, 1>
+    GLuint VAO{ 0 }, VBO{ 0 }, EBO{ 0 };
+
+    ShaderProgram* depth_shader = nullptr;
+    glm::vec3 camera_position{};
+
+    // GL state before BeginQueries()
+    GLboolean color_mask[4]{};
+    GLboolean depth_mask{};
+    GLboolean is_cull_face_on{};
+
+    int occluded_count = 0;
+};
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <iostream>
+
+#include "OffscreenTarget.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void OffscreenTarget::Init(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenRenderbuffers(1, &color_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::exception("OffscreenTarget: Framebuffer incomplete\n");
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    print("OffscreenTarget: " << width << "x" << height);
+}
+
+void OffscreenTarget::Bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+}
+
+Image OffscreenTarget::Read()
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.channels = 4;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+    // GL has the bottom row first
+    for (int y = 0; y < height / 2; y++) {
+        std::swap_ranges(image.Row(y), image.Row(y) + width * 4, image.Row(height - 1 - y));
+    }
+    for (size_t i = 3; i < image.pixels.size(); i += 4) {
+        image.pixels[i] = 255; // Clear color has alpha 0
+    }
+    return image;
+}
+
+void OffscreenTarget::Clear()
+{
+    if (FBO) { glDeleteFramebuffers(1, &FBO); FBO = 0; }
+    if (color_renderbuffer) { glDeleteRenderbuffers(1, &color_renderbuffer); color_renderbuffer = 0; }
+    if (depth_renderbuffer) { glDeleteRenderbuffers(1, &depth_renderbuffer); depth_renderbuffer = 0; }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "Image.hpp"
+
+// Framebuffer the scene is rendered into in the headless mode, instead of the default one of a window
+// - RGBA8 color, depth the same as the default framebuffer (WeightedBlendedOIT blits it)
+// - Read() returns what was drawn, e.g. for PNG dumps
+class OffscreenTarget
+{
+public:
+    void Init(int width, int height); // Valid GL context must exist
+    void Bind();                      // Every frame before drawing
+    Image Read();                     // RGBA, top row first; waits for the GPU
+    void Clear();
+
+    bool IsValid() const { return FBO != 0; }
+private:
+    int width = 0;
+    int height = 0;
+
+    // OpenGL IDs, 0 == uninitialized
+    GLuint FBO{ 0 };
+    GLuint color_renderbuffer{ 0 };
+    GLuint depth_renderbuffer{ 0 };
+};
@@ -0,0 +1,54 @@
+#include "ImageDecoder.hpp"
+
+#if IMAGE_DECODER_OPENCV
+
+#include <cstring>
+#include <iostream>
+
+#include <opencv2/opencv.hpp>
+
+#include "OpenCVImageBackend.hpp"
+
+#ifdef _DEBUG
+#pragma comment(lib, "opencv_world490d.lib")
+#else
+#pragma comment(lib, "opencv_world490.lib")
+#endif
+
+#define print(x) //std::cout << x << "\n"
+
+bool OpenCVImageBackend::Decode(const std::vector<unsigned char>& file, int channels, Image& image) const
+{
+    cv::Mat mat = cv::imdecode(file, channels == IMAGE_CHANNELS_GRAY ? cv::IMREAD_GRAYSCALE : cv::IMREAD_UNCHANGED);
+    if (mat.empty()) return false;
+
+    if (mat.depth() != CV_8U) {
+        double scale = mat.depth() == CV_16U ? 1.0 / 256.0 : mat.depth() == CV_32F || mat.depth() == CV_64F ? 255.0 : 1.0;
+        mat.convertTo(mat, CV_8U, scale);
+    }
+    bool is_gray = mat.channels() == 1 && channels != IMAGE_CHANNELS_RGBA;
+    switch (mat.channels()) {
+    case 1:
+        if (!is_gray) cv::cvtColor(mat, mat, cv::COLOR_GRAY2RGBA);
+        break;
+    case 3:
+        cv::cvtColor(mat, mat, channels == IMAGE_CHANNELS_GRAY ? cv::COLOR_BGR2GRAY : cv::COLOR_BGR2RGBA);
+        break;
+    case 4:
+        cv::cvtColor(mat, mat, channels == IMAGE_CHANNELS_GRAY ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGRA2RGBA);
+        break;
+    default:
+        return false;
+    }
+
+    image.width = mat.cols;
+    image.height = mat.rows;
+    image.channels = mat.channels();
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * image.channels);
+    for (int y = 0; y < image.height; y++) {
+        std::memcpy(image.Row(y), mat.ptr<unsigned char>(y), static_cast<size_t>(image.width) * image.channels);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "ImageBackend.hpp"
+
+// Everything OpenCV can read (BMP, TIFF, interlaced PNG, ...), only with IMAGE_DECODER_OPENCV
+class OpenCVImageBackend : public ImageBackend
+{
+public:
+    const char* GetName() const override { return "OpenCV"; }
+    bool Decode(const std::vector<unsigned char>& file, int channels, Image& image) const override;
+};
@@ -2,8 +2,11 @@
 
 App app;
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (!app.ParseArguments(argc, argv)) {
+        return EXIT_FAILURE;
+    }
     if (app.Init()) {
         return app.Run();
     }
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+struct ProfilerEvent {
+    const char* name;
+    uint64_t begin;
+    union {
+        uint64_t end;  // Zone
+        double value;  // Counter
+    };
+    bool is_counter;
+};
+
+struct ProfilerThread {
+    std::mutex mutex; // Taken by Save() only while copying, never contended otherwise
+    std::vector<ProfilerEvent> events;
+    size_t next = 0;  // Ring buffer position
+    bool is_full = false;
+    int id = 0;
+    std::string name;
+};
+
+// Never destroyed: threads of std::async may end after static destructors ran
+struct ProfilerRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfilerThread>> threads;
+    std::vector<ProfilerThread*> unused; // Of finished threads (kept in traces until reused), the next new thread takes and clears one
+};
+static ProfilerRegistry& registry = *new ProfilerRegistry;
+
+static const auto start_timestamp = std::chrono::steady_clock::now();
+
+// Buffer of the calling thread, given back when the thread ends
+struct ProfilerThreadOwner {
+    ProfilerThread* thread = nullptr;
+    ~ProfilerThreadOwner()
+    {
+        if (!thread) return;
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.unused.push_back(thread);
+    }
+};
+static thread_local ProfilerThreadOwner owner;
+
+// Registry must be locked
+static ProfilerThread* CreateThread()
+{
+    registry.threads.push_back(std::make_unique<ProfilerThread>());
+    ProfilerThread* thread = registry.threads.back().get();
+    thread->id = static_cast<int>(registry.threads.size());
+    thread->name = "Thread " + std::to_string(thread->id);
+    thread->events.resize(PROFILER_EVENTS_PER_THREAD);
+    return thread;
+}
+
+static ProfilerThread& GetThread()
+{
+    if (owner.thread) return *owner.thread;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (!registry.unused.empty()) {
+        owner.thread = registry.unused.back();
+        registry.unused.pop_back();
+        // Events and name of the finished thread must not end up on the track of this one
+        std::lock_guard<std::mutex> thread_lock(owner.thread->mutex);
+        owner.thread->next = 0;
+        owner.thread->is_full = false;
+        owner.thread->name = "Thread " + std::to_string(owner.thread->id);
+    }
+    else {
+        owner.thread = CreateThread();
+    }
+    return *owner.thread;
+}
+
+static void AddEvent(ProfilerThread& thread, const ProfilerEvent& event)
+{
+    std::lock_guard<std::mutex> lock(thread.mutex);
+    thread.events[thread.next] = event;
+    if (++thread.next == thread.events.size()) {
+        thread.next = 0;
+        thread.is_full = true;
+    }
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+    ProfilerThread& thread = GetThread();
+    std::lock_guard<std::mutex> lock(thread.mutex);
+    thread.name = name;
+}
+
+uint64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_timestamp).count();
+}
+
+void Profiler::AddZone(const char* name, uint64_t begin, uint64_t end)
+{
+    ProfilerEvent event;
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.is_counter = false;
+    AddEvent(GetThread(), event);
+}
+
+void Profiler::AddCounter(const char* name, double value)
+{
+    if (!IsRecording()) return;
+    ProfilerEvent event;
+    event.name = name;
+    event.begin = Now();
+    event.value = value;
+    event.is_counter = true;
+    AddEvent(GetThread(), event);
+}
+
+int Profiler::AddTrack(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ProfilerThread* track = CreateThread();
+    track->name = name;
+    return track->id;
+}
+
+void Profiler::AddZone(int track, const char* name, uint64_t begin, uint64_t end)
+{
+    if (!IsRecording()) return;
+    ProfilerThread* thread;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        thread = registry.threads[track - 1].get();
+    }
+    ProfilerEvent event;
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.is_counter = false;
+    AddEvent(*thread, event);
+}
+
+static void WriteString(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+    }
+    out << '"';
+}
+
+bool Profiler::Save(const std::filesystem::path& path)
+{
+    // Copy first, threads wait only for the copy of their own buffer
+    struct Track {
+        int id;
+        std::string name;
+        std::vector<ProfilerEvent> events;
+    };
+    std::vector<Track> tracks;
+    {
+        std::lock_guard<std::mutex> registry_lock(registry.mutex);
+        for (const auto& thread : registry.threads) {
+            std::lock_guard<std::mutex> lock(thread->mutex);
+            Track track{ thread->id, thread->name, {} };
+            if (thread->is_full) track.events.insert(track.events.end(), thread->events.begin() + thread->next, thread->events.end());
+            track.events.insert(track.events.end(), thread->events.begin(), thread->events.begin() + thread->next);
+            tracks.push_back(std::move(track));
+        }
+    }
+
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Profiler: Can not write " << path << "\n";
+        return false;
+    }
+    file << std::fixed << std::setprecision(3); // Microseconds
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"PG2\"}}";
+    size_t n_events = 0;
+    for (const auto& track : tracks) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.id << ",\"args\":{\"name\":";
+        WriteString(file, track.name);
+        file << "}}";
+        file << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.id << ",\"args\":{\"sort_index\":" << track.id << "}}";
+        for (const auto& event : track.events) {
+            file << ",\n{\"name\":";
+            WriteString(file, event.name);
+            if (event.is_counter) {
+                file << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << track.id << ",\"ts\":" << event.begin / 1000.0 << ",\"args\":{\"value\":" << event.value << "}}";
+            }
+            else {
+                file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << track.id << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+            }
+        }
+        n_events += track.events.size();
+    }
+    file << "\n]}\n";
+    print("Profiler: " << n_events << " events of " << tracks.size() << " threads to " << path);
+    return file.good();
+}
+
+std::filesystem::path Profiler::Save()
+{
+    std::filesystem::path path = std::filesystem::path(PROFILER_DIR) / ("trace_" + std::to_string(std::time(nullptr)) + ".json");
+    return Save(path) ? path : std::filesystem::path();
+}
+
+void Profiler::Clear()
+{
+    std::lock_guard<std::mutex> registry_lock(registry.mutex);
+    for (const auto& thread : registry.threads) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->next = 0;
+        thread->is_full = false;
+    }
+}
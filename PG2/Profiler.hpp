@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#define PROFILER_ENABLED 1                // 0 compiles all zones, counters and thread names out
+#define PROFILER_EVENTS_PER_THREAD 65536  // Ring buffer of each thread, oldest events are overwritten (~30 s of frames on the main thread)
+#define PROFILER_DIR "./profiles"         // Save() without a path writes here
+
+// Scoped CPU zones, counters and thread names, saved as Chrome trace JSON (chrome://tracing, https://ui.perfetto.dev)
+// - records all the time like a flight recorder: after a spike was seen, Save() writes the last events of every thread
+// - a zone costs two clock reads and one store into the buffer of its own thread, under a per-thread mutex
+//   that only Save()/Clear() take as well (uncontended otherwise)
+// - names must be string literals, only the pointer is stored
+// - not recording (SetRecording) leaves one relaxed atomic load per zone, PROFILER_ENABLED 0 leaves nothing
+class Profiler
+{
+public:
+    static void SetRecording(bool is_recording) { recording.store(is_recording, std::memory_order_relaxed); }
+    static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+    static void SetThreadName(const std::string& name); // Track name of the calling thread
+
+    static uint64_t Now(); // Nanoseconds since start
+    static void AddZone(const char* name, uint64_t begin, uint64_t end);
+    static void AddCounter(const char* name, double value);
+
+    // Tracks not bound to a thread, e.g. GPU zones measured later; any thread can add to them
+    static int AddTrack(const std::string& name);
+    static void AddZone(int track, const char* name, uint64_t begin, uint64_t end);
+
+    static bool Save(const std::filesystem::path& path); // Any thread, recording goes on meanwhile
+    static std::filesystem::path Save();                 // PROFILER_DIR/trace_<time>.json, empty path if it failed
+    static void Clear();
+private:
+    static inline std::atomic<bool> recording{ true };
+};
+
+// Zone from construction to End() or the end of the scope
+class ProfilerZone
+{
+public:
+    explicit ProfilerZone(const char* name)
+#if PROFILER_ENABLED
+        : name(Profiler::IsRecording() ? name : nullptr), begin(this->name ? Profiler::Now() : 0)
+#endif
+    {}
+    ~ProfilerZone() { End(); }
+    ProfilerZone(const ProfilerZone&) = delete;
+    ProfilerZone& operator=(const ProfilerZone&) = delete;
+
+    void End()
+    {
+#if PROFILER_ENABLED
+        if (!name) return;
+        Profiler::AddZone(name, begin, Profiler::Now());
+        name = nullptr;
+#endif
+    }
+private:
+#if PROFILER_ENABLED
+    const char* name;
+    uint64_t begin;
+#endif
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name) ProfilerZone PROFILER_CONCAT(profiler_zone_, __LINE__)(name) // Till the end of the scope
+#define PROFILE_COUNTER(name, value) Profiler::AddCounter(name, static_cast<double>(value))
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
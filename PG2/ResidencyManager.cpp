@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "ResidencyManager.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void ResidencyManager::Init(const std::vector<Model*>& models, const TextureTable& table)
+{
+    used_bytes = 0;
+    textures.resize(table.GetTextureCount());
+    for (int i = 0; i < table.GetTextureCount(); i++) {
+        auto& texture = textures[i];
+        texture.cache_path = TextureGetCachePath(table.GetTextureKey(i));
+        texture.bytes = table.GetTextureBytes(i);
+        texture.last_visible = 0;
+        texture.can_reduce = table.IsBindless() && !texture.cache_path.empty();
+        texture.is_reduced = false;
+        used_bytes += texture.bytes;
+    }
+    for (auto model : models) {
+        Mesh& mesh = model->GetMesh();
+        meshes.push_back({ model, mesh.GetGPUBytes(), 0, model->chunks.empty() && !mesh.IsDynamic() });
+        used_bytes += mesh.GetGPUBytes();
+    }
+    print("ResidencyManager: " << used_bytes / (1024 * 1024) << " MB of " << budget / (1024 * 1024) << " MB budget");
+}
+
+void ResidencyManager::Update(TextureTable& table, TextureStreamer& streamer)
+{
+    PROFILE_ZONE("ResidencyManager::Update");
+    frame++;
+
+    // Visible models: mesh back right away (drawn this frame), texture is reloaded in the background
+    for (auto& mesh : meshes) {
+        if (!mesh.model->is_visible) continue;
+        mesh.last_visible = frame;
+        Mesh& model_mesh = mesh.model->GetMesh();
+        if (!model_mesh.IsResident()) {
+            model_mesh.Restore();
+            used_bytes += mesh.bytes;
+            evicted_count--;
+        }
+        if (model_mesh.texture_index < 0) continue;
+        auto& texture = textures[model_mesh.texture_index];
+        texture.last_visible = frame;
+        if (texture.is_reduced && texture.can_reduce && !texture.reload.valid()) { // can_reduce is cleared when a reload failed, no retry
+            texture.reload = std::async(std::launch::async, [path = texture.cache_path]() {
+                CookedTexture cooked;
+                if (!TextureLoadDDS(path, cooked)) cooked = CookedTexture();
+                return cooked;
+            });
+        }
+    }
+
+    // Reloaded textures: coarse levels now, fine ones through the streamer
+    for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+        auto& texture = textures[i];
+        if (!texture.reload.valid() || texture.reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        CookedTexture cooked = texture.reload.get();
+        if (cooked.levels.empty()) {
+            std::cerr << "ResidencyManager: Can not reload " << texture.cache_path << ", keeping coarse levels\n";
+            texture.can_reduce = false; // Stays reduced, never reloaded or reduced again
+            continue;
+        }
+        used_bytes -= texture.bytes;
+        table.Restore(i, cooked, streamer);
+        texture.bytes = table.GetTextureBytes(i);
+        used_bytes += texture.bytes;
+        texture.is_reduced = false;
+        evicted_count--;
+    }
+
+    if (used_bytes <= budget) return;
+
+    // Over budget: least recently visible first, fine mips before the mesh of the same model
+    candidates.clear();
+    for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+        const auto& texture = textures[i];
+        if (texture.can_reduce && !texture.is_reduced && !texture.reload.valid() && frame - texture.last_visible >= RESIDENCY_MIN_AGE
+            && streamer.GetMinLevel(table.GetTextureKey(i)) == 0) { // Not being streamed
+            candidates.push_back({ texture.last_visible, 0, i });
+        }
+    }
+    for (int i = 0; i < static_cast<int>(meshes.size()); i++) {
+        const auto& mesh = meshes[i];
+        if (mesh.can_evict && mesh.model->GetMesh().IsResident() && frame - mesh.last_visible >= RESIDENCY_MIN_AGE) {
+            candidates.push_back({ mesh.last_visible, 1, i });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto [last_visible, kind, i] : candidates) {
+        if (used_bytes <= budget) break;
+        if (kind == 0) {
+            auto& texture = textures[i];
+            if (!table.Reduce(i, TEXTURE_STREAM_RESIDENT_SIZE)) {
+                texture.can_reduce = false; // Small already
+                continue;
+            }
+            used_bytes -= texture.bytes;
+            texture.bytes = table.GetTextureBytes(i);
+            used_bytes += texture.bytes;
+            texture.is_reduced = true;
+        }
+        else {
+            meshes[i].model->GetMesh().Evict();
+            used_bytes -= meshes[i].bytes;
+        }
+        evicted_count++;
+    }
+    print("ResidencyManager: " << used_bytes / (1024 * 1024) << " MB, " << evicted_count << " evicted");
+}
+
+void ResidencyManager::Clear()
+{
+    textures.clear(); // Waits for reloads
+    meshes.clear();
+    candidates.clear();
+    used_bytes = 0;
+    evicted_count = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <tuple>
+#include <vector>
+
+#include "Model.hpp"
+#include "TextureCooker.hpp"
+#include "TextureStreamer.hpp"
+#include "TextureTable.hpp"
+
+#define RESIDENCY_BUDGET (256 * 1024 * 1024) // Bytes of textures and meshes on GPU, least recently visible models are evicted above it
+#define RESIDENCY_MIN_AGE 120                // Frames a model must be out of view before it can be evicted (turning around does not reload)
+
+// Keeps textures and meshes of the scene within a GPU memory budget
+// - over the budget, models not visible for the longest time lose fine mip levels of their texture first, then their mesh
+// - visible again: mesh is uploaded from its CPU copy, texture is read from the DDS cache (worker thread) and streamed in
+// - fine mip levels are dropped only with bindless textures (layers of texture arrays share storage), meshes always
+// - heightmap and dynamic meshes are never evicted
+class ResidencyManager
+{
+public:
+    void Init(const std::vector<Model*>& models, const TextureTable& table); // After TextureTable::Build()
+    void Update(TextureTable& table, TextureStreamer& streamer);             // Every frame after culling (is_visible), before drawing
+    void Clear();
+
+    void SetBudget(size_t bytes) { budget = bytes; }
+    size_t GetBudget() const { return budget; }
+    size_t GetUsedBytes() const { return used_bytes; }
+    int GetEvictedCount() const { return evicted_count; } // Reduced textures + evicted meshes
+private:
+    struct TextureResidency {
+        std::filesystem::path cache_path;   // Reloaded from here
+        size_t bytes;                       // On GPU now
+        uint64_t last_visible;              // Frame
+        bool can_reduce;                    // Bindless and cooked
+        bool is_reduced;
+        std::future<CookedTexture> reload;  // Started when a model using it is visible again
+    };
+    std::vector<TextureResidency> textures; // Same indices as TextureTable
+
+    struct MeshResidency {
+        Model* model;
+        size_t bytes;
+        uint64_t last_visible;
+        bool can_evict;
+    };
+    std::vector<MeshResidency> meshes;
+
+    std::vector<std::tuple<uint64_t, int, int>> candidates; // (last visible, 0 = texture / 1 = mesh, index), reused every frame
+
+    size_t budget = RESIDENCY_BUDGET;
+    size_t used_bytes = 0;
+    int evicted_count = 0;
+    uint64_t frame = 0;
+};
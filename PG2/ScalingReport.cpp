@@ -0,0 +1,92 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "ScalingReport.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void ScalingReport::Init(const std::vector<int>& instances, double step_seconds, int lights, float shots_per_second)
+{
+    this->instances = instances;
+    this->step_seconds = step_seconds;
+    this->lights = lights;
+    this->shots_per_second = shots_per_second;
+    rows.clear();
+    step = 0;
+    step_start = -1.0;
+    is_measuring = false;
+}
+
+bool ScalingReport::AddFrame(double timestamp, float frame_ms, float cpu_ms, int models, int visible_models)
+{
+    uint64_t frame = frame_number++;
+    if (IsDone()) return false;
+    if (step_start < 0.0) step_start = timestamp;
+
+    if (!is_measuring) {
+        if (timestamp - step_start < SCALING_WARMUP_SECONDS) return false;
+        is_measuring = true;
+        stats = FrameStats(SCALING_STEP_FRAMES);
+        first_measured = frame;
+        measured_frames = 0;
+        visible_sum = 0.0;
+    }
+    stats.AddFrame(timestamp, frame_ms, cpu_ms);
+    measured_frames++;
+    visible_sum += visible_models;
+    if (timestamp - step_start < SCALING_WARMUP_SECONDS + step_seconds && measured_frames < SCALING_STEP_FRAMES) return false;
+
+    // Step is over
+    rows.push_back({ instances[step], models, static_cast<float>(visible_sum / measured_frames), measured_frames, stats.GetCPUSummary(), stats.GetGPUSummary() });
+    std::cout << "Stress: " << rows.back().instances << " instances, " << models << " models, " << std::fixed << std::setprecision(2)
+        << rows.back().cpu.p50 << " ms p50 of " << measured_frames << " frames" << std::defaultfloat << "\n";
+    step++;
+    step_start = -1.0;
+    is_measuring = false;
+    return true;
+}
+
+void ScalingReport::SetGPUTime(uint64_t frame, float gpu_ms)
+{
+    if (is_measuring && frame >= first_measured) stats.SetGPUTime(frame - first_measured, gpu_ms);
+}
+
+void ScalingReport::Print() const
+{
+    std::cout << "Scaling: " << lights << " moving lights, " << shots_per_second << " shots/s, " << step_seconds << " s per step\n"
+        << " instances  models  visible  cpu p50  cpu p99  gpu p50  gpu p99  ms/100 models\n" << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        std::cout << std::setw(10) << row.instances << std::setw(8) << row.models << std::setw(9) << row.visible_models
+            << std::setw(9) << row.cpu.p50 << std::setw(9) << row.cpu.p99 << std::setw(9) << row.gpu.p50 << std::setw(9) << row.gpu.p99;
+        if (i > 0 && row.models != rows[i - 1].models) {
+            std::cout << std::setw(15) << (row.cpu.p50 - rows[i - 1].cpu.p50) * 100.0f / (row.models - rows[i - 1].models);
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
+bool ScalingReport::SaveCSV(const std::filesystem::path& path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "ScalingReport: Can not write " << path << "\n";
+        return false;
+    }
+    file << "instances,models,visible_models,lights,shots_per_second,frames,"
+        "cpu_avg_ms,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,cpu_max_ms,cpu_low_1_ms,cpu_hitches,"
+        "gpu_avg_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms,gpu_max_ms,cpu_ms_per_100_models\n" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        file << row.instances << "," << row.models << "," << row.visible_models << "," << lights << "," << shots_per_second << "," << row.frames << ","
+            << row.cpu.avg << "," << row.cpu.p50 << "," << row.cpu.p95 << "," << row.cpu.p99 << "," << row.cpu.max << "," << row.cpu.low_1 << "," << row.cpu.hitches << ","
+            << row.gpu.avg << "," << row.gpu.p50 << "," << row.gpu.p95 << "," << row.gpu.p99 << "," << row.gpu.max << ",";
+        if (i > 0 && row.models != rows[i - 1].models) file << (row.cpu.p50 - rows[i - 1].cpu.p50) * 100.0f / (row.models - rows[i - 1].models);
+        file << "\n";
+    }
+    return file.good();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "FrameStats.hpp"
+
+#define SCALING_WARMUP_SECONDS 1.0 // Not measured after the scene changes (uploads, residency, sorting)
+#define SCALING_STEP_FRAMES 65536  // Most frames measured per step, a faster step ends early so the statistics cover all of them
+
+// Frame times of a stress run at growing scene sizes, one step per size
+// - every step is warmed up first, then measured for a fixed time (or SCALING_STEP_FRAMES frames)
+// - CPU/GPU statistics per step go to the console and a CSV: frame time versus the number of instances,
+//   with the cost of 100 more models against the previous step (where the scene stops scaling)
+class ScalingReport
+{
+public:
+    void Init(const std::vector<int>& instances, double step_seconds, int lights, float shots_per_second);
+    bool IsDone() const { return step >= instances.size(); }
+    int GetInstances() const { return IsDone() ? 0 : instances[step]; } // Of the current step
+
+    // Once per frame, frames count from 0 like FrameStats; true = next step (or the end), the scene must change
+    bool AddFrame(double timestamp, float frame_ms, float cpu_ms, int models, int visible_models);
+    void SetGPUTime(uint64_t frame, float gpu_ms); // Known a few frames later
+
+    void Print() const;
+    bool SaveCSV(const std::filesystem::path& path) const;
+private:
+    struct Row {
+        int instances;
+        int models;
+        float visible_models; // Average
+        int frames;           // Measured
+        FrameStats::Summary cpu, gpu;
+    };
+    std::vector<Row> rows;
+
+    std::vector<int> instances;
+    double step_seconds = 0.0;
+    int lights = 0;
+    float shots_per_second = 0.0f;
+
+    size_t step = 0;
+    double step_start = -1.0;   // Timestamp, < 0 = the step did not start yet
+    bool is_measuring = false;
+    FrameStats stats{ 0 };      // Of the measured part of the step, sized when it starts
+    uint64_t frame_number = 0;
+    uint64_t first_measured = 0; // Frame number where the measured part started
+    int measured_frames = 0;
+    double visible_sum = 0.0;
+};
@@ -1,4 +1,6 @@
+#include <cstdint>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -9,23 +11,107 @@
 
 #define print(x) //std::cout << x << "\n"
 
-ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file)
+ShaderProgram::ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const std::vector<std::string>& defines) :
+	VS_file(VS_file),
+	FS_file(FS_file),
+	defines(defines)
 {
-	std::vector<GLuint> shader_ids;
-	
-	shader_ids.push_back(CompileShader(VS_file, GL_VERTEX_SHADER));
-	shader_ids.push_back(CompileShader(FS_file, GL_FRAGMENT_SHADER));
-
-	ID = LinkShader(shader_ids);
-	print("Instantiated shader ID=" << ID);
+	// Only issued here, finished by first Activate(); creating many programs in a row lets driver compile them in parallel
+	BeginBuild();
 }
 
 void ShaderProgram::Activate(void)
 {
+	// First build must succeed, there is no older program to fall back to
+	if (!ID && pending_ID && !FinishBuild())
+		throw std::exception("Shader build err.\n");
 	print("Activating shader ID=" << ID);
 	glUseProgram(ID);
 }
 
+void ShaderProgram::Reload(void)
+{
+	// Newer sources win over a build that is still running
+	if (pending_ID) DiscardBuild();
+	try {
+		BeginBuild();
+	}
+	catch (std::exception const& e) {
+		std::cerr << "Shader reload failed: " << e.what(); // e.g. file is being saved; keep the old program
+	}
+}
+
+bool ShaderProgram::Update(void)
+{
+	if (!pending_ID || !IsBuildDone()) return false;
+	return FinishBuild();
+}
+
+void ShaderProgram::BeginBuild()
+{
+	std::string vs_source = InjectDefines(TextFileRead(VS_file));
+	std::string fs_source = InjectDefines(TextFileRead(FS_file));
+
+	// Linked before with the same sources and driver?
+	pending_binary_path = GetBinaryPath({ vs_source, fs_source });
+	pending_ID = LoadBinary(pending_binary_path);
+	if (pending_ID) return;
+
+	pending_shader_ids.push_back(CompileShader(vs_source, GL_VERTEX_SHADER));
+	pending_shader_ids.push_back(CompileShader(fs_source, GL_FRAGMENT_SHADER));
+	pending_ID = LinkShader(pending_shader_ids);
+}
+
+bool ShaderProgram::IsBuildDone()
+{
+	// Without the extension, any status query waits for the compiler, so the build is "done" and may stall one frame
+	if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile) return true;
+	GLint is_done = GL_FALSE;
+	glGetProgramiv(pending_ID, GL_COMPLETION_STATUS_KHR, &is_done);
+	return is_done == GL_TRUE;
+}
+
+bool ShaderProgram::FinishBuild()
+{
+	// check compile and link result, display error (if any)
+	GLint status;
+	glGetProgramiv(pending_ID, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		for (const auto id : pending_shader_ids) {
+			GLint cmpl_status;
+			glGetShaderiv(id, GL_COMPILE_STATUS, &cmpl_status);
+			if (cmpl_status == GL_FALSE) std::cerr << "Shader compilation err.\n" << GetShaderInfoLog(id);
+		}
+		std::cerr << "Link err. (" << VS_file << ", " << FS_file << ")\n" << GetProgramInfoLog(pending_ID);
+		DiscardBuild();
+		return false;
+	}
+
+	if (!pending_shader_ids.empty()) SaveBinary(pending_binary_path, pending_ID);
+	for (const auto id : pending_shader_ids) {
+		glDetachShader(pending_ID, id);
+		glDeleteShader(id);
+	}
+	pending_shader_ids.clear();
+
+	// Swap; GL state is touched only from the main thread between draws, so the swap is atomic for rendering
+	if (ID) glDeleteProgram(ID);
+	ID = pending_ID;
+	pending_ID = 0;
+	print("Instantiated shader ID=" << ID);
+	return true;
+}
+
+void ShaderProgram::DiscardBuild()
+{
+	for (const auto id : pending_shader_ids) {
+		glDeleteShader(id);
+	}
+	pending_shader_ids.clear();
+	glDeleteProgram(pending_ID);
+	pending_ID = 0;
+}
+
 void ShaderProgram::Deactivate(void)
 {
 	glUseProgram(0);
@@ -34,6 +120,7 @@ void ShaderProgram::Deactivate(void)
 void ShaderProgram::Clear(void)
 {
 	Deactivate();
+	if (pending_ID) DiscardBuild();
 	glDeleteProgram(ID);
 	ID = 0;
 }
@@ -124,25 +211,15 @@ std::string ShaderProgram::GetProgramInfoLog(const GLuint obj)
 	return s;
 }
 
-GLuint ShaderProgram::CompileShader(const std::filesystem::path& source_file, const GLenum type)
+GLuint ShaderProgram::CompileShader(const std::string& source, const GLenum type)
 {
 	// create and use shaders
 	GLuint shader_h = glCreateShader(type);
 	
-	//const char* shader_string = TextFileRead(source_file).c_str(); // Dangling pointer, does not work
-	std::string str = TextFileRead(source_file);
-	const char* shader_string = str.c_str();
+	const char* shader_string = source.c_str();
 
 	glShaderSource(shader_h, 1, &shader_string, NULL);
-	glCompileShader(shader_h);
-	{ // check compile result, display error (if any)
-		GLint cmpl_status;
-		glGetShaderiv(shader_h, GL_COMPILE_STATUS, &cmpl_status);
-		if (cmpl_status == GL_FALSE) {
-			std::cerr << GetShaderInfoLog(shader_h);
-			throw std::exception("Shader compilation err.\n");
-		}
-	}
+	glCompileShader(shader_h); // result is checked in FinishBuild(), asking now would wait for the compiler
 	return shader_h;
 }
 
@@ -152,20 +229,83 @@ GLuint ShaderProgram::LinkShader(const std::vector<GLuint> shader_ids)
 	for (const auto id : shader_ids) {
 		glAttachShader(prog_h, id);
 	}
+	glProgramParameteri(prog_h, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // for SaveBinary()
 
-	glLinkProgram(prog_h);
-	{ // check link result, display error (if any)
-		GLint status;
-		glGetProgramiv(prog_h, GL_LINK_STATUS, &status);
-		if (status == GL_FALSE) {
-			std::cerr << GetProgramInfoLog(prog_h);
-			throw std::exception("Link err.\n");
+	glLinkProgram(prog_h); // result is checked in FinishBuild()
+	return prog_h;
+}
+
+std::filesystem::path ShaderProgram::GetBinaryPath(const std::vector<std::string>& sources)
+{
+	// FNV-1a, 64 bit (std::hash is not guaranteed to be the same between runs)
+	std::uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const std::string& str) {
+		for (unsigned char c : str) {
+			hash = (hash ^ c) * 1099511628211ull;
 		}
+		hash = (hash ^ 0xff) * 1099511628211ull; // separator, "ab"+"c" != "a"+"bc"
+	};
+	for (const auto& source : sources) {
+		add(source);
 	}
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		auto str = reinterpret_cast<const char*>(glGetString(name));
+		add(str ? str : "");
+	}
+
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+	return std::filesystem::path(SHADER_CACHE_DIR) / ss.str();
+}
+
+GLuint ShaderProgram::LoadBinary(const std::filesystem::path& path)
+{
+	GLint n_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+	if (n_formats == 0) return 0;
+
+	// File: GLenum format + binary
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return 0;
+	GLenum format{};
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty()) return 0;
 
+	GLuint prog_h = glCreateProgram();
+	glProgramBinary(prog_h, format, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint status;
+	glGetProgramiv(prog_h, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		// Driver changed in a way the key does not capture, or file is damaged -> compile from sources
+		std::cerr << "Cached shader binary rejected, recompiling: " << path << "\n";
+		glDeleteProgram(prog_h);
+		return 0;
+	}
 	return prog_h;
 }
 
+void ShaderProgram::SaveBinary(const std::filesystem::path& path, const GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector<char> binary(length);
+	GLenum format{};
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	// Cache is optional, failing to write it is not an error
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Can not write shader cache: " << path << "\n";
+		return;
+	}
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(binary.data(), binary.size());
+}
+
 std::string ShaderProgram::TextFileRead(const std::filesystem::path& fn)
 {
 	std::ifstream file(fn);
@@ -175,3 +315,21 @@ std::string ShaderProgram::TextFileRead(const std::filesystem::path& fn)
 	ss << file.rdbuf();
 	return ss.str();
 }
+
+std::string ShaderProgram::InjectDefines(const std::string& source)
+{
+	if (defines.empty()) return source;
+
+	// #version must stay the first line
+	size_t version_end = 0;
+	if (source.compare(0, 8, "#version") == 0) {
+		version_end = source.find('\n');
+		version_end = version_end == std::string::npos ? source.size() : version_end + 1;
+	}
+	std::string injected;
+	for (const auto& define : defines) {
+		injected += "#define " + define + "\n";
+	}
+	injected += "#line 2\n"; // Compiler errors keep line numbers of the file
+	return source.substr(0, version_end) + injected + source.substr(version_end);
+}
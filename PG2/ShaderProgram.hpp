@@ -4,17 +4,24 @@
 #include <GL/glew.h>
 
 #include <filesystem>
+#include <vector>
+
+#define SHADER_CACHE_DIR "./cache/shaders" // Linked program binaries, see ShaderProgram::LoadBinary()
 
 class ShaderProgram {
 public:
 	// you can add more constructors for pipeline with GS, TS etc.
 	ShaderProgram() = default; // does nothing (tell the compiler to do what it would have if we didn't define a ctor)
-	ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file); // load, compile, and link shader
+	ShaderProgram(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const std::vector<std::string>& defines = {}); // load, compile, and link shader; defines ("NAME" or "NAME VALUE") are injected after #version
 
 	void Activate();
 	void Deactivate();
 	void Clear();
 
+	// Hot reload: old program is used until the new one is compiled and linked; on error it stays
+	void Reload();  // Start compiling current sources in the background
+	bool Update();  // Call every frame; swaps in the new program when it is ready, true if swapped
+
 	// set uniform according to name :: https://docs.gl/gl4/glUniform
 	void SetUniform(const std::string& name, const float val);
 	void SetUniform(const std::string& name, const int val);
@@ -25,10 +32,28 @@ public:
 
 private:
 	GLuint ID{ 0 }; // default = 0, empty shader
+	std::filesystem::path VS_file, FS_file;
+	std::vector<std::string> defines;
+
+	// Build in progress (with GL_KHR_parallel_shader_compile the driver compiles and links on its own threads)
+	GLuint pending_ID{ 0 };
+	std::vector<GLuint> pending_shader_ids;  // empty if loaded from binary cache
+	std::filesystem::path pending_binary_path;
+	void BeginBuild();   // Issue compile + link (or load cached binary), does not wait
+	bool IsBuildDone();  // Never waits
+	bool FinishBuild();  // Waits if needed; on success replaces ID, on error prints logs and keeps ID
+	void DiscardBuild();
+
 	std::string GetShaderInfoLog(const GLuint obj);   // check for shader compilation error; if any, print compiler output  
 	std::string GetProgramInfoLog(const GLuint obj);  // check for linker error; if any, print linker output
 
-	GLuint CompileShader(const std::filesystem::path& source_file, const GLenum type); // try to load and compile shader
-	GLuint LinkShader(const std::vector<GLuint> shader_ids);                           // try to link all shader IDs to final program
+	GLuint CompileShader(const std::string& source, const GLenum type);                // start compiling shader
+	GLuint LinkShader(const std::vector<GLuint> shader_ids);                           // start linking all shader IDs to final program
+
+	// Program binary cache; file name is hash of sources + driver (vendor, renderer, version), any driver update invalidates it
+	std::filesystem::path GetBinaryPath(const std::vector<std::string>& sources);
+	GLuint LoadBinary(const std::filesystem::path& path);                              // 0 if there is no cached binary or driver rejects it
+	void SaveBinary(const std::filesystem::path& path, const GLuint program);
 	std::string TextFileRead(const std::filesystem::path& filename);                   // load text file
+	std::string InjectDefines(const std::string& source);                              // add #defines after #version line
 };
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <immintrin.h>
+
+#include "SoftwareOcclusionCuller.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+#define SW_OCCLUSION_NEAR_W 0.001f // Triangles/boxes with vertex closer than this are not rasterized/tested (they'd need clipping)
+
+void SoftwareOcclusionCuller::AddOccluder(Model* model)
+{
+    occluders.push_back({ model, glm::mat4(1.0f) });
+}
+
+void SoftwareOcclusionCuller::BeginRasterize(const glm::mat4& mx_view_projection)
+{
+    // Worker must not touch Models, main thread is updating them meanwhile
+    this->mx_view_projection = mx_view_projection;
+    for (auto& occluder : occluders) {
+        occluder.mx_model_view_projection = mx_view_projection * occluder.model->GetModelMatrix();
+    }
+    occluded_count = 0;
+    tested_count = 0;
+    worker = std::async(std::launch::async, &SoftwareOcclusionCuller::Rasterize, this);
+}
+
+void SoftwareOcclusionCuller::EndRasterize()
+{
+    if (worker.valid()) worker.get();
+}
+
+glm::vec4 SoftwareOcclusionCuller::ToScreen(glm::vec4 clip) const
+{
+    float inv_w = 1.0f / clip.w;
+    return glm::vec4(
+        (clip.x * inv_w * 0.5f + 0.5f) * SW_OCCLUSION_WIDTH,
+        (clip.y * inv_w * 0.5f + 0.5f) * SW_OCCLUSION_HEIGHT,
+        clip.z * inv_w * 0.5f + 0.5f,
+        clip.w);
+}
+
+void SoftwareOcclusionCuller::Rasterize()
+{
+    std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+
+    for (const auto& occluder : occluders) {
+        // Vertex and index arrays are never changed after loading, reading them here is safe
+        const auto& vertices = occluder.model->GetMeshVertices();
+        const auto& indices = occluder.model->GetMeshIndices();
+
+        screen_vertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            glm::vec4 clip = occluder.mx_model_view_projection * glm::vec4(vertices[i].position, 1.0f);
+            screen_vertices[i] = clip.w > SW_OCCLUSION_NEAR_W ? ToScreen(clip) : glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+        }
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            RasterizeTriangle(screen_vertices[indices[i]], screen_vertices[indices[i + 1]], screen_vertices[indices[i + 2]]);
+        }
+    }
+
+    BuildTiles();
+}
+
+void SoftwareOcclusionCuller::RasterizeTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2)
+{
+    // Crossing near plane -> skip, less occlusion is always safe
+    if (v0.w < 0.0f || v1.w < 0.0f || v2.w < 0.0f) return;
+
+    // Both windings are accepted (terrain seen from below still occludes)
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < 1e-6f) return;
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // Bounding rectangle in pixels
+    int min_x = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+    int max_x = std::min(SW_OCCLUSION_WIDTH - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+    int min_y = std::max(0, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+    int max_y = std::min(SW_OCCLUSION_HEIGHT - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+    if (min_x > max_x || min_y > max_y) return;
+    min_x &= ~3; // Whole SSE blocks
+
+    // Edge functions E(p) = (b - a) x (p - a), all >= 0 inside; and depth plane, all linear in x and y
+    auto edge = [](glm::vec4 a, glm::vec4 b, float px, float py) { return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x); };
+    float start_x = min_x + 0.5f;
+    float start_y = min_y + 0.5f;
+    float e0 = edge(v1, v2, start_x, start_y), e0_dx = -(v2.y - v1.y), e0_dy = v2.x - v1.x;
+    float e1 = edge(v2, v0, start_x, start_y), e1_dx = -(v0.y - v2.y), e1_dy = v0.x - v2.x;
+    float e2 = edge(v0, v1, start_x, start_y), e2_dx = -(v1.y - v0.y), e2_dy = v1.x - v0.x;
+    float z = (e0 * v0.z + e1 * v1.z + e2 * v2.z) / area;
+    float z_dx = (e0_dx * v0.z + e1_dx * v1.z + e2_dx * v2.z) / area;
+    float z_dy = (e0_dy * v0.z + e1_dy * v1.z + e2_dy * v2.z) / area;
+
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 e0_row = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(lanes, _mm_set1_ps(e0_dx)));
+    __m128 e1_row = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(lanes, _mm_set1_ps(e1_dx)));
+    __m128 e2_row = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(lanes, _mm_set1_ps(e2_dx)));
+    __m128 z_row = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(lanes, _mm_set1_ps(z_dx)));
+    const __m128 e0_step_x = _mm_set1_ps(4.0f * e0_dx), e0_step_y = _mm_set1_ps(e0_dy);
+    const __m128 e1_step_x = _mm_set1_ps(4.0f * e1_dx), e1_step_y = _mm_set1_ps(e1_dy);
+    const __m128 e2_step_x = _mm_set1_ps(4.0f * e2_dx), e2_step_y = _mm_set1_ps(e2_dy);
+    const __m128 z_step_x = _mm_set1_ps(4.0f * z_dx), z_step_y = _mm_set1_ps(z_dy);
+
+    for (int y = min_y; y <= max_y; y++) {
+        __m128 e0_4 = e0_row, e1_4 = e1_row, e2_4 = e2_row, z_4 = z_row;
+        float* row = &depth_buffer[y * SW_OCCLUSION_WIDTH];
+        for (int x = min_x; x <= max_x; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0_4, zero), _mm_cmpge_ps(e1_4, zero)), _mm_cmpge_ps(e2_4, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 depth = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(depth, z_4);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+            }
+            e0_4 = _mm_add_ps(e0_4, e0_step_x);
+            e1_4 = _mm_add_ps(e1_4, e1_step_x);
+            e2_4 = _mm_add_ps(e2_4, e2_step_x);
+            z_4 = _mm_add_ps(z_4, z_step_x);
+        }
+        e0_row = _mm_add_ps(e0_row, e0_step_y);
+        e1_row = _mm_add_ps(e1_row, e1_step_y);
+        e2_row = _mm_add_ps(e2_row, e2_step_y);
+        z_row = _mm_add_ps(z_row, z_step_y);
+    }
+}
+
+void SoftwareOcclusionCuller::BuildTiles()
+{
+    // Farthest depth of every tile, if box is nearer than this it may be visible
+    const int n_tiles_x = SW_OCCLUSION_WIDTH / SW_OCCLUSION_TILE;
+    const int n_tiles_y = SW_OCCLUSION_HEIGHT / SW_OCCLUSION_TILE;
+    for (int tile_y = 0; tile_y < n_tiles_y; tile_y++) {
+        for (int tile_x = 0; tile_x < n_tiles_x; tile_x++) {
+            __m128 max_4 = _mm_setzero_ps();
+            for (int y = tile_y * SW_OCCLUSION_TILE; y < (tile_y + 1) * SW_OCCLUSION_TILE; y++) {
+                const float* row = &depth_buffer[y * SW_OCCLUSION_WIDTH + tile_x * SW_OCCLUSION_TILE];
+                for (int x = 0; x < SW_OCCLUSION_TILE; x += 4) {
+                    max_4 = _mm_max_ps(max_4, _mm_loadu_ps(row + x));
+                }
+            }
+            float max[4];
+            _mm_storeu_ps(max, max_4);
+            tile_max_depth[tile_y * n_tiles_x + tile_x] = std::max({ max[0], max[1], max[2], max[3] });
+        }
+    }
+}
+
+bool SoftwareOcclusionCuller::IsOccluded(glm::vec4 world_bounds)
+{
+    tested_count++;
+
+    // Screen rectangle and nearest depth of the box around bounding sphere
+    glm::vec3 center(world_bounds);
+    float radius = world_bounds.w;
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX, min_depth = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+        glm::vec4 clip = mx_view_projection * glm::vec4(center + offset, 1.0f);
+        if (clip.w < SW_OCCLUSION_NEAR_W) return false; // Box around camera
+        glm::vec4 screen = ToScreen(clip);
+        min_x = std::min(min_x, screen.x);
+        min_y = std::min(min_y, screen.y);
+        max_x = std::max(max_x, screen.x);
+        max_y = std::max(max_y, screen.y);
+        min_depth = std::min(min_depth, screen.z);
+    }
+    int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+    int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+    int x1 = std::min(SW_OCCLUSION_WIDTH - 1, static_cast<int>(std::floor(max_x)));
+    int y1 = std::min(SW_OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor(max_y)));
+    if (x0 > x1 || y0 > y1) return false; // Off screen, frustum culling decides
+
+    // Coarse: tiles; fine: pixels of tiles that are not fully nearer than the box
+    const int n_tiles_x = SW_OCCLUSION_WIDTH / SW_OCCLUSION_TILE;
+    for (int tile_y = y0 / SW_OCCLUSION_TILE; tile_y <= y1 / SW_OCCLUSION_TILE; tile_y++) {
+        for (int tile_x = x0 / SW_OCCLUSION_TILE; tile_x <= x1 / SW_OCCLUSION_TILE; tile_x++) {
+            if (tile_max_depth[tile_y * n_tiles_x + tile_x] < min_depth) continue;
+            int py0 = std::max(y0, tile_y * SW_OCCLUSION_TILE), py1 = std::min(y1, (tile_y + 1) * SW_OCCLUSION_TILE - 1);
+            int px0 = std::max(x0, tile_x * SW_OCCLUSION_TILE), px1 = std::min(x1, (tile_x + 1) * SW_OCCLUSION_TILE - 1);
+            for (int y = py0; y <= py1; y++) {
+                for (int x = px0; x <= px1; x++) {
+                    if (depth_buffer[y * SW_OCCLUSION_WIDTH + x] >= min_depth) return false;
+                }
+            }
+        }
+    }
+
+    occluded_count++;
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <future>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Model.hpp"
+
+#define SW_OCCLUSION_WIDTH 256  // Resolution of the software depth buffer (width must be a multiple of 4 and of SW_OCCLUSION_TILE)
+#define SW_OCCLUSION_HEIGHT 128
+#define SW_OCCLUSION_TILE 8     // Tile size of the hierarchical (max) depth buffer
+
+// Software occlusion culling, no GPU round-trips, deterministic
+// - occluders (heightmap, big static props) are rasterized into a small depth buffer on a worker thread (SSE, 4 pixels at a time)
+// - occludees' bounding boxes are then tested against per-tile max depth, and per pixel where tiles are not conclusive
+class SoftwareOcclusionCuller
+{
+public:
+    void AddOccluder(Model* model);
+
+    void BeginRasterize(const glm::mat4& mx_view_projection); // Start rasterizing occluders on a worker thread
+    void EndRasterize();                                        // Wait for the worker
+    bool IsOccluded(glm::vec4 world_bounds);                    // Test bounding sphere (as box) against rasterized occluders, after EndRasterize()
+
+    int GetOccludedCount() const { return occluded_count; }
+    int GetTestedCount() const { return tested_count; }
+private:
+    struct Occluder {
+        Model* model;
+        glm::mat4 mx_model_view_projection; // Snapshot made on the main thread
+    };
+    std::vector<Occluder> occluders;
+    std::future<void> worker;
+    glm::mat4 mx_view_projection{};
+
+    std::vector<float> depth_buffer = std::vector<float>(SW_OCCLUSION_WIDTH * SW_OCCLUSION_HEIGHT);
+    std::vector<float> tile_max_depth = std::vector<float>((SW_OCCLUSION_WIDTH / SW_OCCLUSION_TILE) * (SW_OCCLUSION_HEIGHT / SW_OCCLUSION_TILE));
+    std::vector<glm::vec4> screen_vertices; // xy pixels, z depth <0, 1>, w clip w
+
+    int occluded_count = 0;
+    int tested_count = 0;
+
+    void Rasterize(); // Runs on worker
+    void RasterizeTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2);
+    void BuildTiles();
+    glm::vec4 ToScreen(glm::vec4 clip) const;
+};
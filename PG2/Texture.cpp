@@ -1,23 +1,155 @@
-#include <opencv2\opencv.hpp>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
 
 #include "texture.hpp"
+#include "ImageDecoder.hpp"
+#include "Profiler.hpp"
+#include "TextureCooker.hpp"
+#include "TextureStreamer.hpp"
 
 #define print(x) //std::cout << x << "\n"
 
+static TextureStreamer* texture_streamer = nullptr;
+static ImageDecoder* image_decoder = nullptr;
+
+// Everything TextureInit() does before GL calls, runs on decoder threads
+struct TextureData {
+	bool is_cooked = false;
+	CookedTexture cooked;
+	std::filesystem::path cache_path; // Cooked and in the cache
+	Image image; // Not cooked: decoded image for TextureGen(), empty if it can not be read
+};
+static std::map<std::string, std::shared_future<TextureData>> prefetched;
+static std::map<std::pair<std::string, int>, std::shared_future<Image>> prefetched_images;
+static std::map<GLuint, std::filesystem::path> cache_paths;
+
+void TextureSetStreamer(TextureStreamer* streamer)
+{
+	texture_streamer = streamer;
+}
+
+void TextureSetDecoder(ImageDecoder* decoder)
+{
+	image_decoder = decoder;
+	if (!decoder) {
+		// Loading is over, do not keep the data
+		prefetched.clear();
+		prefetched_images.clear();
+	}
+}
+
+// Images of the same name in different directories must not share the cache file: name + hash of the full path
+static std::filesystem::path TextureCachePath(const std::filesystem::path& image_path)
+{
+	std::error_code ec;
+	std::string full_path = std::filesystem::absolute(image_path, ec).lexically_normal().generic_string();
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(std::hash<std::string>{}(full_path)));
+	return std::filesystem::path(TEXTURE_CACHE_DIR) / (image_path.filename().string() + "." + hash + ".dds");
+}
+
+static TextureData TexturePrepare(const std::filesystem::path& image_path)
+{
+	PROFILE_ZONE("TexturePrepare");
+	TextureData data;
+
+	// Cooked before? DDS in cache must be newer than the image
+	std::filesystem::path cache_path = TextureCachePath(image_path);
+	bool can_cook = GLEW_EXT_texture_compression_s3tc;
+	std::error_code ec;
+	if (can_cook && std::filesystem::exists(cache_path, ec)
+		&& std::filesystem::last_write_time(cache_path, ec) >= std::filesystem::last_write_time(image_path, ec) && !ec) {
+		if (TextureLoadDDS(cache_path, data.cooked)) {
+			print("TextureInit: " << image_path << " from " << cache_path);
+			data.is_cooked = true;
+			data.cache_path = cache_path;
+			return data;
+		}
+		std::cerr << "TextureInit: Damaged cache " << cache_path << ", cooking again\n";
+	}
+
+	data.image = ImageDecoder::Decode(image_path);
+	if (data.image.IsEmpty()) return data;
+
+	// Encode BCn mip chain once, next runs only read the file
+	if (can_cook) {
+		print("TextureInit: Cooking " << image_path);
+		data.cooked = TextureCook(data.image);
+		data.is_cooked = true;
+		data.image = Image();
+		if (TextureSaveDDS(data.cooked, cache_path)) {
+			data.cache_path = cache_path;
+		}
+		else {
+			std::cerr << "TextureInit: Can not write texture cache " << cache_path << "\n";
+		}
+	}
+	return data;
+}
+
+void TexturePrefetch(const std::filesystem::path& image_path)
+{
+	auto& future = prefetched[image_path.string()];
+	if (future.valid()) return;
+	future = image_decoder ? image_decoder->Run([image_path]() { return TexturePrepare(image_path); }).share()
+		: std::async(std::launch::deferred, TexturePrepare, image_path).share();
+}
+
+void ImagePrefetch(const std::filesystem::path& image_path, int channels)
+{
+	auto& future = prefetched_images[{ image_path.string(), channels }];
+	if (future.valid()) return;
+	future = image_decoder ? image_decoder->Run([image_path, channels]() { return ImageDecoder::Decode(image_path, channels); }).share()
+		: std::async(std::launch::deferred, ImageDecoder::Decode, image_path, channels).share();
+}
+
+Image ImageLoad(const std::filesystem::path& image_path, int channels)
+{
+	ImagePrefetch(image_path, channels); // Nothing if it was prefetched
+	return prefetched_images[{ image_path.string(), channels }].get();
+}
+
+static GLuint TextureUploadCooked(CookedTexture& cooked)
+{
+	if (!texture_streamer) return TextureUpload(cooked);
+	GLuint texture = TextureUpload(cooked, TextureStreamer::GetResidentLevel(cooked));
+	texture_streamer->Queue(texture, cooked);
+	return texture;
+}
+
+std::filesystem::path TextureGetCachePath(GLuint texture)
+{
+	auto it = cache_paths.find(texture);
+	return it == cache_paths.end() ? std::filesystem::path() : it->second;
+}
+
 GLuint TextureInit(const char* filepath)
 {
-	cv::Mat image = cv::imread(filepath, cv::IMREAD_UNCHANGED);
-	if (image.empty()) {
+	PROFILE_ZONE("TextureInit");
+	TexturePrefetch(filepath); // Nothing if it was prefetched
+	TextureData data = prefetched[filepath].get(); // Copy, the same file may be used again (streamer takes levels away)
+	if (!image_decoder) prefetched.erase(filepath);
+
+	if (data.is_cooked) {
+		GLuint texture = TextureUploadCooked(data.cooked);
+		if (!data.cache_path.empty()) cache_paths[texture] = data.cache_path;
+		return texture;
+	}
+	if (data.image.IsEmpty()) {
 		std::cerr << "TextureInit: No texture " << filepath << "\n";
 		exit(1);
 	}
+
 	print("TextureInit: Started generating texture with TextureGen(" << filepath << "):\n");
-	return TextureGen(image);
+	return TextureGen(data.image);
 }
 
-GLuint TextureGen(cv::Mat& image)
+GLuint TextureGen(Image& image)
 {
-	if (image.empty()) {
+	if (image.IsEmpty()) {
 		throw std::exception("TextureGen: Image empty(?)\n");
 	}
 
@@ -29,19 +161,15 @@ GLuint TextureGen(cv::Mat& image)
 		throw std::exception("TextureGen: Compressed textures not supported(?)\n");
 	}
 
-	switch (image.channels()) {
+	switch (image.channels) {
 	case 1:
 		img_internalformat = GL_COMPRESSED_RED;
 		img_format = GL_RED;
 		break;
-	case 3:
-		img_internalformat = GL_COMPRESSED_RGB;
-		img_format = GL_BGR;
-		break;
 	case 4:
-		// if channels() == RGBA, we have a Alpha channel, aka semitransparent texture
+		// ImageDecoder gives RGBA for all color images
 		img_internalformat = GL_COMPRESSED_RGBA;
-		img_format = GL_BGRA;
+		img_format = GL_RGBA;
 		break;
 	default:
 		throw std::exception("TextureGen: Unsupported number of channels\n");
@@ -66,7 +194,7 @@ GLuint TextureGen(cv::Mat& image)
 		//glHint(GL_TEXTURE_COMPRESSION_HINT, GL_FASTEST);
 		glHint(GL_TEXTURE_COMPRESSION_HINT, GL_NICEST);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, img_internalformat, image.cols, image.rows, 0, img_format, GL_UNSIGNED_BYTE, image.data);
+		glTexImage2D(GL_TEXTURE_2D, 0, img_internalformat, image.width, image.height, 0, img_format, GL_UNSIGNED_BYTE, image.pixels.data());
 
 		// Is it now really compressed? Did we succeed?
 		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
@@ -74,7 +202,7 @@ GLuint TextureGen(cv::Mat& image)
 		if (compressed == GL_TRUE) {
 			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalformat);
 			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressed_size);
-			print("TextureGen: ORIGINAL: " << image.total() * image.elemSize() << " COMPRESSED: " << compressed_size << " INTERNAL FORMAT: " << internalformat << "\n\n");
+			print("TextureGen: ORIGINAL: " << image.pixels.size() << " COMPRESSED: " << compressed_size << " INTERNAL FORMAT: " << internalformat << "\n\n");
 		}
 	}
 	else {
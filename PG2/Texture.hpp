@@ -3,13 +3,35 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
-#include <opencv2\opencv.hpp>
+#include <filesystem>
+
 #include <GL/glew.h>
 
+#include "Image.hpp"
+
+class ImageDecoder;
+class TextureStreamer;
+
+// with a streamer, cooked textures upload only coarse levels and stream the rest (nullptr = all levels at once)
+void TextureSetStreamer(TextureStreamer* streamer);
+
+// with a decoder, prefetched files are decoded/cooked on its threads (nullptr = on the GL thread, drops prefetched data)
+void TextureSetDecoder(ImageDecoder* decoder);
+
+// start everything TextureInit(image_path) does before the upload, in the background
+void TexturePrefetch(const std::filesystem::path& image_path);
+
+// decoded image (ImageDecoder::Decode, channels = IMAGE_CHANNELS_*), ImagePrefetch() starts it in the background
+void ImagePrefetch(const std::filesystem::path& image_path, int channels);
+Image ImageLoad(const std::filesystem::path& image_path, int channels);
+
 // generate GL texture from image file
 GLuint TextureInit(const char* filepath);
 
-// generate GL texture from OpenCV image
-GLuint TextureGen(cv::Mat& image);
+// DDS in the texture cache a texture made by TextureInit() was uploaded from (empty if it was not cooked)
+std::filesystem::path TextureGetCachePath(GLuint texture);
+
+// generate GL texture from decoded image
+GLuint TextureGen(Image& image);
 
 #endif
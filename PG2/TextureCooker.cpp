@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <thread>
+
+#include "TextureCooker.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+//
+// https://learn.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+//
+
+// === Block encoders :: 4x4 RGBA pixels -> 8 bytes ===
+
+static uint16_t To565(const float color[3])
+{
+	auto quantize = [](float value, int max) { return static_cast<uint16_t>(std::clamp(value, 0.0f, 255.0f) * max / 255.0f + 0.5f); };
+	return (quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31);
+}
+
+static void From565(uint16_t color, float out[3])
+{
+	int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	out[0] = static_cast<float>((r << 3) | (r >> 2));
+	out[1] = static_cast<float>((g << 2) | (g >> 4));
+	out[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// BC1 color block, always in 4 color mode (as BC3 requires)
+static void EncodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+	// Endpoints: extremes along principal axis of the colors (power iteration on covariance)
+	float mean[3]{};
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++) mean[c] += block[i][c] / 16.0f;
+	float cov[6]{}; // rr rg rb gg gb bb
+	for (int i = 0; i < 16; i++) {
+		float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b; cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float length = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+		if (length < 1e-6f) break; // Flat block, keep (1, 1, 1)
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+	float axis_length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float min_t = FLT_MAX, max_t = -FLT_MAX;
+	for (int i = 0; i < 16; i++) {
+		float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / axis_length2;
+		min_t = std::min(min_t, t);
+		max_t = std::max(max_t, t);
+	}
+	// Inset a little, extremes are usually outliers
+	float inset = (max_t - min_t) / 16.0f;
+	min_t += inset;
+	max_t -= inset;
+	float color_max[3], color_min[3];
+	for (int c = 0; c < 3; c++) {
+		color_max[c] = mean[c] + axis[c] * max_t;
+		color_min[c] = mean[c] + axis[c] * min_t;
+	}
+	uint16_t c0 = To565(color_max), c1 = To565(color_min);
+	if (c0 < c1) std::swap(c0, c1);
+
+	// Palette of the 4 color mode and nearest entry for every pixel
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		float palette[4][3];
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		for (int i = 0; i < 16; i++) {
+			uint32_t best = 0;
+			float best_error = FLT_MAX;
+			for (uint32_t p = 0; p < 4; p++) {
+				float r = block[i][0] - palette[p][0], g = block[i][1] - palette[p][1], b = block[i][2] - palette[p][2];
+				float error = r * r + g * g + b * b;
+				if (error < best_error) { best_error = error; best = p; }
+			}
+			indices |= best << (2 * i);
+		}
+	}
+	out[0] = c0 & 0xff; out[1] = c0 >> 8;
+	out[2] = c1 & 0xff; out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// BC4 block of a single channel (also BC3 alpha)
+static void EncodeSingleChannelBlock(const unsigned char block[16][4], int channel, unsigned char* out)
+{
+	unsigned char a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, block[i][channel]);
+		a1 = std::min(a1, block[i][channel]);
+	}
+
+	// 8 value mode (a0 > a1): a0, a1, then 6 interpolated values
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		float palette[8] = { static_cast<float>(a0), static_cast<float>(a1) };
+		for (int p = 1; p < 7; p++) {
+			palette[p + 1] = ((7 - p) * a0 + p * a1) / 7.0f;
+		}
+		for (int i = 0; i < 16; i++) {
+			uint64_t best = 0;
+			float best_error = FLT_MAX;
+			for (uint64_t p = 0; p < 8; p++) {
+				float error = std::abs(block[i][channel] - palette[p]);
+				if (error < best_error) { best_error = error; best = p; }
+			}
+			indices |= best << (3 * i);
+		}
+	}
+	out[0] = a0;
+	out[1] = a1;
+	for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// === Cooking ===
+
+static size_t BlockBytes(GLenum format)
+{
+	return format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+}
+
+static size_t LevelBytes(GLenum format, int width, int height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+// Rows of blocks [first_row, last_row), out has the size of the whole level
+static void EncodeRows(const Image& rgba, GLenum format, std::vector<unsigned char>& out, int first_row, int last_row)
+{
+	int blocks_x = (rgba.width + 3) / 4;
+	size_t block_bytes = BlockBytes(format);
+	unsigned char block[16][4];
+	for (int by = first_row; by < last_row; by++) {
+		for (int bx = 0; bx < blocks_x; bx++) {
+			// Gather pixels, clamped at the edges of images that are not multiples of 4
+			for (int i = 0; i < 16; i++) {
+				int x = std::min(bx * 4 + i % 4, rgba.width - 1);
+				int y = std::min(by * 4 + i / 4, rgba.height - 1);
+				std::memcpy(block[i], rgba.Row(y) + 4 * x, 4);
+			}
+			unsigned char* dst = &out[(static_cast<size_t>(by) * blocks_x + bx) * block_bytes];
+			switch (format) {
+			case GL_COMPRESSED_RED_RGTC1:
+				EncodeSingleChannelBlock(block, 0, dst);
+				break;
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+				EncodeColorBlock(block, dst);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				EncodeSingleChannelBlock(block, 3, dst);
+				EncodeColorBlock(block, dst + 8);
+				break;
+			}
+		}
+	}
+}
+
+static void EncodeLevel(const Image& rgba, GLenum format, std::vector<unsigned char>& out)
+{
+	int blocks_y = (rgba.height + 3) / 4;
+	out.resize(LevelBytes(format, rgba.width, rgba.height));
+
+	// Rows of blocks are independent
+	int n_threads = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), blocks_y));
+	std::vector<std::future<void>> workers;
+	for (int t = 0; t < n_threads; t++) {
+		workers.push_back(std::async(std::launch::async, EncodeRows, std::cref(rgba), format, std::ref(out), blocks_y * t / n_threads, blocks_y * (t + 1) / n_threads));
+	}
+	for (auto& worker : workers) {
+		worker.get();
+	}
+}
+
+std::vector<unsigned char> TextureEncode(const Image& rgba, GLenum format)
+{
+	std::vector<unsigned char> out(LevelBytes(format, rgba.width, rgba.height));
+	EncodeRows(rgba, format, out, 0, (rgba.height + 3) / 4);
+	return out;
+}
+
+static bool IsOpaque(const Image& rgba)
+{
+	for (size_t i = 3; i < rgba.pixels.size(); i += 4) {
+		if (rgba.pixels[i] != 255) return false;
+	}
+	return true;
+}
+
+Image TextureDownsample(const Image& rgba)
+{
+	Image half;
+	half.width = std::max(1, rgba.width / 2);
+	half.height = std::max(1, rgba.height / 2);
+	half.channels = 4;
+	half.pixels.resize(static_cast<size_t>(half.width) * half.height * 4);
+	// Clamped reads only matter for a size of 1, which stays 1
+	for (int y = 0; y < half.height; y++) {
+		const unsigned char* row0 = rgba.Row(std::min(2 * y, rgba.height - 1));
+		const unsigned char* row1 = rgba.Row(std::min(2 * y + 1, rgba.height - 1));
+		unsigned char* dst = half.Row(y);
+		for (int x = 0; x < half.width; x++) {
+			int x0 = 4 * std::min(2 * x, rgba.width - 1), x1 = 4 * std::min(2 * x + 1, rgba.width - 1);
+			for (int c = 0; c < 4; c++) {
+				dst[4 * x + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+	return half;
+}
+
+CookedTexture TextureCook(const Image& image)
+{
+	PROFILE_ZONE("TextureCook");
+	if (image.IsEmpty()) {
+		throw std::exception("TextureCook: Image empty\n");
+	}
+
+	CookedTexture texture;
+	texture.width = image.width;
+	texture.height = image.height;
+	Image rgba;
+	switch (image.channels) {
+	case 1:
+		texture.format = GL_COMPRESSED_RED_RGTC1;
+		rgba.width = image.width;
+		rgba.height = image.height;
+		rgba.channels = 4;
+		rgba.pixels.resize(image.pixels.size() * 4);
+		for (size_t i = 0; i < image.pixels.size(); i++) {
+			std::memset(&rgba.pixels[i * 4], image.pixels[i], 3);
+			rgba.pixels[i * 4 + 3] = 255;
+		}
+		break;
+	case 4:
+		texture.format = IsOpaque(image) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		rgba = image;
+		break;
+	default:
+		throw std::exception("TextureCook: Unsupported number of channels\n");
+	}
+
+	// Mip chain down to 1x1, box filtered
+	while (true) {
+		texture.levels.emplace_back();
+		EncodeLevel(rgba, texture.format, texture.levels.back());
+		if (rgba.width == 1 && rgba.height == 1) break;
+		rgba = TextureDownsample(rgba);
+	}
+	print("TextureCook: " << texture.width << "x" << texture.height << ", " << texture.levels.size() << " levels");
+	return texture;
+}
+
+// === DDS ===
+
+struct DDSHeader {
+	uint32_t size = 124;
+	uint32_t flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT, LINEARSIZE
+	uint32_t height = 0;
+	uint32_t width = 0;
+	uint32_t linear_size = 0;
+	uint32_t depth = 0;
+	uint32_t mipmap_count = 0;
+	uint32_t reserved1[11]{};
+	// DDS_PIXELFORMAT
+	uint32_t pf_size = 32;
+	uint32_t pf_flags = 0x4; // FOURCC
+	uint32_t pf_fourcc = 0;
+	uint32_t pf_rgb_bit_count = 0;
+	uint32_t pf_masks[4]{};
+	//
+	uint32_t caps = 0x1000 | 0x400000 | 0x8; // TEXTURE, MIPMAP, COMPLEX
+	uint32_t caps2 = 0;
+	uint32_t caps3 = 0;
+	uint32_t caps4 = 0;
+	uint32_t reserved2 = 0;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+
+static uint32_t FourCC(const char* code)
+{
+	return code[0] | (code[1] << 8) | (code[2] << 16) | (code[3] << 24);
+}
+
+bool TextureSaveDDS(const CookedTexture& texture, const std::filesystem::path& path)
+{
+	DDSHeader header;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.linear_size = static_cast<uint32_t>(texture.levels[0].size());
+	header.mipmap_count = static_cast<uint32_t>(texture.levels.size());
+	header.pf_fourcc = FourCC(texture.format == GL_COMPRESSED_RED_RGTC1 ? "ATI1" : texture.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "DXT1" : "DXT5");
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	file.write("DDS ", 4);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& level : texture.levels) {
+		file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	}
+	return file.good();
+}
+
+bool TextureLoadDDS(const std::filesystem::path& path, CookedTexture& texture)
+{
+	PROFILE_ZONE("TextureLoadDDS");
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	char magic[4];
+	DDSHeader header;
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good() || std::memcmp(magic, "DDS ", 4) != 0 || header.size != 124) return false;
+
+	if (header.pf_fourcc == FourCC("ATI1")) texture.format = GL_COMPRESSED_RED_RGTC1;
+	else if (header.pf_fourcc == FourCC("DXT1")) texture.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else if (header.pf_fourcc == FourCC("DXT5")) texture.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else return false;
+	texture.width = header.width;
+	texture.height = header.height;
+
+	texture.levels.clear();
+	int width = texture.width, height = texture.height;
+	for (uint32_t level = 0; level < std::max(header.mipmap_count, 1u); level++) {
+		texture.levels.emplace_back(LevelBytes(texture.format, width, height));
+		file.read(reinterpret_cast<char*>(texture.levels.back().data()), texture.levels.back().size());
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return file.good();
+}
+
+GLuint TextureUpload(const CookedTexture& texture, int first_level)
+{
+	GLuint texture_id;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture_id);
+	glTextureStorage2D(texture_id, static_cast<GLsizei>(texture.levels.size()), texture.format, texture.width, texture.height);
+	int width = texture.width, height = texture.height;
+	for (size_t level = 0; level < texture.levels.size(); level++) {
+		if (static_cast<int>(level) >= first_level) glCompressedTextureSubImage2D(texture_id, static_cast<GLint>(level), 0, 0, width, height, texture.format,
+			static_cast<GLsizei>(texture.levels[level].size()), texture.levels[level].data());
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	// Same as TextureGen(): tiled, trilinear
+	glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	return texture_id;
+}
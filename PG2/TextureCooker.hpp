@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Image.hpp"
+
+#define TEXTURE_CACHE_DIR "./cache/textures" // Cooked (block compressed) textures, see TextureInit()
+
+// Block compressed texture with whole mip chain, as stored in a DDS file
+struct CookedTexture {
+	GLenum format{}; // GL_COMPRESSED_RED_RGTC1 (BC4), GL_COMPRESSED_RGB_S3TC_DXT1_EXT (BC1) or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT (BC3)
+	int width{};
+	int height{};
+	std::vector<std::vector<unsigned char>> levels; // level 0 = full size
+};
+
+// encode image from ImageDecoder (gray -> BC4, opaque RGBA -> BC1, RGBA -> BC3) with all mip levels; blocks are encoded in parallel
+CookedTexture TextureCook(const Image& image);
+
+// one level of RGBA image (4 channels) in given format, on the calling thread (small images, caller runs them in parallel)
+std::vector<unsigned char> TextureEncode(const Image& rgba, GLenum format);
+
+// half size RGBA image (rounded down like GL mip levels, the last row/column of odd sizes is left out), 2x2 box filter, as for the mip levels of TextureCook()
+Image TextureDownsample(const Image& rgba);
+
+// DDS file (legacy header, FourCC ATI1/DXT1/DXT5)
+bool TextureSaveDDS(const CookedTexture& texture, const std::filesystem::path& path);
+bool TextureLoadDDS(const std::filesystem::path& path, CookedTexture& texture);
+
+// generate GL texture from cooked mip levels, no driver side compression or mipmap generation
+// - levels finer than first_level get storage only (TextureStreamer fills them later)
+GLuint TextureUpload(const CookedTexture& texture, int first_level = 0);
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "TextureStreamer.hpp"
+#include "Profiler.hpp"
+#include "TextureTable.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void TextureStreamer::Init()
+{
+    // Persistent coherent mapping, as dynamic Mesh does
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &PBO);
+    glNamedBufferStorage(PBO, TEXTURE_STREAM_BUDGET * TEXTURE_STREAM_REGIONS, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapNamedBufferRange(PBO, 0, TEXTURE_STREAM_BUDGET * TEXTURE_STREAM_REGIONS, flags));
+    if (!mapped)
+        throw std::exception("TextureStreamer: failed to map pixel unpack buffer\n");
+}
+
+void TextureStreamer::Clear()
+{
+    for (auto& fence : region_fences) {
+        if (fence) { glDeleteSync(fence); fence = nullptr; }
+    }
+    if (mapped) { glUnmapNamedBuffer(PBO); mapped = nullptr; }
+    glDeleteBuffers(1, &PBO);
+    PBO = 0;
+    requests.clear();
+    min_levels.clear();
+    pending_bytes = 0;
+}
+
+int TextureStreamer::GetResidentLevel(const CookedTexture& cooked)
+{
+    int level = 0;
+    int size = std::max(cooked.width, cooked.height);
+    while (level + 1 < static_cast<int>(cooked.levels.size()) && size > TEXTURE_STREAM_RESIDENT_SIZE) {
+        level++;
+        size = std::max(1, size / 2);
+    }
+    return level;
+}
+
+void TextureStreamer::Queue(GLuint texture, CookedTexture& cooked)
+{
+    int first_resident = GetResidentLevel(cooked);
+    int width = cooked.width, height = cooked.height;
+    for (int level = 0; level < first_resident; level++) {
+        Request request{ texture, texture, -1, cooked.format, level, width, height, std::move(cooked.levels[level]), 0 };
+        pending_bytes += request.data.size();
+        requests.insert({ request.data.size(), std::move(request) });
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    min_levels[texture] = first_resident;
+}
+
+void TextureStreamer::Retarget(GLuint texture, GLuint array, int layer)
+{
+    for (auto& [bytes, request] : requests) {
+        if (request.texture == texture) {
+            request.target = array;
+            request.layer = layer;
+        }
+    }
+}
+
+int TextureStreamer::GetMinLevel(GLuint texture) const
+{
+    auto it = min_levels.find(texture);
+    return it == min_levels.end() ? 0 : it->second;
+}
+
+void TextureStreamer::Update(TextureTable& table)
+{
+    PROFILE_ZONE("TextureStreamer::Update");
+    if (requests.empty()) return;
+
+    // Region written TEXTURE_STREAM_REGIONS frames ago must not be read by GPU anymore
+    region = (region + 1) % TEXTURE_STREAM_REGIONS;
+    if (region_fences[region]) {
+        GLenum result = glClientWaitSync(region_fences[region], 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(region_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+        glDeleteSync(region_fences[region]);
+        region_fences[region] = nullptr;
+    }
+
+    size_t region_offset = static_cast<size_t>(region) * TEXTURE_STREAM_BUDGET;
+    size_t used = 0;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+    while (!requests.empty()) {
+        auto it = requests.begin();
+        auto& request = it->second;
+
+        // As many whole block rows as fit into the rest of the budget
+        size_t block_bytes = request.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+        size_t row_bytes = ((request.width + 3) / 4) * block_bytes;
+        int block_rows = (request.height + 3) / 4;
+        int rows = std::min(block_rows - request.next_block_row, static_cast<int>((TEXTURE_STREAM_BUDGET - used) / row_bytes));
+        if (rows <= 0) break; // Budget spent
+
+        std::memcpy(mapped + region_offset + used, request.data.data() + request.next_block_row * row_bytes, rows * row_bytes);
+        int y = request.next_block_row * 4;
+        int height = std::min(rows * 4, request.height - y);
+        auto offset = reinterpret_cast<const void*>(region_offset + used);
+        GLsizei bytes = static_cast<GLsizei>(rows * row_bytes);
+        if (request.layer < 0) {
+            glCompressedTextureSubImage2D(request.target, request.level, 0, y, request.width, height, request.format, bytes, offset);
+        }
+        else {
+            glCompressedTextureSubImage3D(request.target, request.level, 0, y, request.layer, request.width, height, 1, request.format, bytes, offset);
+        }
+        used += bytes;
+        pending_bytes -= bytes;
+        request.next_block_row += rows;
+
+        // Level complete, let shaders sample it
+        if (request.next_block_row == block_rows) {
+            print("TextureStreamer: texture " << request.texture << " level " << request.level << " done");
+            min_levels[request.texture] = request.level;
+            table.SetMinLevel(request.texture, request.level);
+            requests.erase(it);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    region_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
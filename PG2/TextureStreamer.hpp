@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "TextureCooker.hpp"
+
+#define TEXTURE_STREAM_BUDGET (2 * 1024 * 1024) // Bytes uploaded per frame at most
+#define TEXTURE_STREAM_REGIONS 3                // Pixel unpack buffer ring: CPU fills one region while GPU reads the others
+#define TEXTURE_STREAM_RESIDENT_SIZE 64         // Mip levels up to this size are uploaded right away, model can be drawn immediately
+
+class TextureTable;
+
+// Streams finer mip levels of cooked textures over the following frames
+// - coarse levels of all textures go first (queue is ordered by level size)
+// - data is copied to a persistently mapped pixel unpack buffer ring, big levels are split into strips of block rows
+class TextureStreamer
+{
+public:
+    void Init();
+    void Clear();
+
+    static int GetResidentLevel(const CookedTexture& cooked); // Finest level that is uploaded right away, TextureUpload(cooked, level)
+    void Queue(GLuint texture, CookedTexture& cooked);        // Takes the levels finer than GetResidentLevel() from cooked
+    void Retarget(GLuint texture, GLuint array, int layer); // Texture was copied into a texture array layer, stream there instead
+    int GetMinLevel(GLuint texture) const;            // Finest level uploaded so far
+    void Update(TextureTable& table);                 // Every frame; uploads up to TEXTURE_STREAM_BUDGET bytes
+
+    size_t GetPendingBytes() const { return pending_bytes; }
+private:
+    struct Request {
+        GLuint texture;       // Key for TextureTable
+        GLuint target;        // Texture that receives the data (texture, or array after Retarget)
+        int layer;            // -1 = 2D texture
+        GLenum format;
+        int level;
+        int width;
+        int height;
+        std::vector<unsigned char> data;
+        int next_block_row;   // Strip upload progress
+    };
+    std::multimap<size_t, Request> requests; // Smallest (coarsest) levels first
+    std::map<GLuint, int> min_levels;
+    size_t pending_bytes = 0;
+
+    GLuint PBO{ 0 };
+    unsigned char* mapped = nullptr;
+    GLsync region_fences[TEXTURE_STREAM_REGIONS]{};
+    int region = 0;
+};
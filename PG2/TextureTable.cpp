@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+#include "TextureTable.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+// Bytes of all levels the texture has storage for
+static size_t GetStorageBytes(GLuint texture)
+{
+    GLint width, height, levels;
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    if (levels == 0) levels = 1 + static_cast<GLint>(std::floor(std::log2(std::max(width, height)))); // Mutable, TextureGen() makes full mip chain
+
+    size_t bytes = 0;
+    for (GLint level = 0; level < levels; level++) {
+        GLint is_compressed = GL_FALSE;
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &is_compressed);
+        if (is_compressed) {
+            GLint size = 0;
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size); // All layers of the level
+            bytes += size;
+        }
+        else {
+            GLint level_width, level_height, depth, red, green, blue, alpha;
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &level_width);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &level_height);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH, &depth);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_RED_SIZE, &red);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_GREEN_SIZE, &green);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_BLUE_SIZE, &blue);
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_ALPHA_SIZE, &alpha);
+            bytes += static_cast<size_t>(level_width) * level_height * depth * (red + green + blue + alpha) / 8;
+        }
+    }
+    return bytes;
+}
+
+void TextureTable::Build(const std::vector<Mesh*>& meshes, TextureStreamer& streamer)
+{
+    PROFILE_ZONE("TextureTable::Build");
+    is_bindless = GLEW_ARB_bindless_texture;
+
+    // Each texture once (meshes may share it)
+    for (auto mesh : meshes) {
+        if (mesh->texture_id == 0) continue;
+        auto [it, is_new] = index_of.insert({ mesh->texture_id, static_cast<int>(textures.size()) });
+        if (is_new) textures.push_back(mesh->texture_id);
+        mesh->texture_index = it->second;
+        mesh->texture_id = 0; // Owned by the table now
+    }
+    keys = textures;
+    entries.resize(textures.size());
+    sizes.resize(textures.size());
+    for (size_t i = 0; i < textures.size(); i++) {
+        entries[i] = { 0, 0, 0, static_cast<float>(streamer.GetMinLevel(textures[i])), 0.0f };
+    }
+
+    if (is_bindless) {
+        for (size_t i = 0; i < textures.size(); i++) {
+            entries[i].handle = glGetTextureHandleARB(textures[i]);
+            glMakeTextureHandleResidentARB(entries[i].handle);
+            sizes[i] = GetStorageBytes(textures[i]);
+        }
+        print("TextureTable: " << textures.size() << " bindless textures");
+    }
+    else {
+        // Group by size and format; textures with the same ones become layers of one array
+        std::map<std::tuple<GLint, GLint, GLint>, std::vector<int>> groups;
+        for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+            GLint width, height, format;
+            glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_WIDTH, &width);
+            glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_HEIGHT, &height);
+            glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            groups[{ width, height, format }].push_back(i);
+        }
+        if (groups.size() > TEXTURE_TABLE_MAX_ARRAYS)
+            throw std::exception("TextureTable: too many different texture sizes/formats\n");
+
+        for (const auto& [key, members] : groups) {
+            auto [width, height, format] = key;
+            GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(std::max(width, height)))); // Full mip chain, as all loaders make
+            GLuint array;
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+            glTextureStorage3D(array, levels, format, width, height, static_cast<GLsizei>(members.size()));
+            for (int layer = 0; layer < static_cast<int>(members.size()); layer++) {
+                // GPU side copy, works for compressed formats too; levels still being streamed will be streamed into the array
+                GLuint texture = textures[members[layer]];
+                for (GLint level = streamer.GetMinLevel(texture); level < levels; level++) {
+                    glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0,
+                        array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                        std::max(1, width >> level), std::max(1, height >> level), 1);
+                }
+                streamer.Retarget(texture, array, layer);
+                entries[members[layer]].array = static_cast<GLint>(arrays.size());
+                entries[members[layer]].layer = layer;
+            }
+            glTextureParameteri(array, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(array, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTextureParameteri(array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(array, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            for (int member : members) {
+                sizes[member] = GetStorageBytes(array) / members.size();
+            }
+            arrays.push_back(array);
+        }
+        print("TextureTable: " << textures.size() << " textures in " << arrays.size() << " arrays");
+
+        // Originals are not needed any more
+        glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+        textures.clear();
+    }
+
+    glCreateBuffers(1, &SSBO);
+    if (entries.empty()) entries.push_back({}); // Empty SSBOs are not allowed
+    glNamedBufferStorage(SSBO, entries.size() * sizeof(Entry), entries.data(), GL_DYNAMIC_STORAGE_BIT);
+}
+
+void TextureTable::Bind(ShaderProgram& shader)
+{
+    // Replaced textures GPU does not use any more
+    while (!retired.empty() && glClientWaitSync(retired.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+        Release(retired.front());
+        retired.pop_front();
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TEXTURE_TABLE_BINDING, SSBO);
+    if (is_bindless) return;
+
+    // Units may have been used by others (OIT composite), bind every frame
+    for (int i = 0; i < static_cast<int>(arrays.size()); i++) {
+        glBindTextureUnit(i, arrays[i]);
+        shader.SetUniform("u_texture_arrays[" + std::to_string(i) + "]", i);
+    }
+}
+
+void TextureTable::SetMinLevel(GLuint texture, int level)
+{
+    auto it = index_of.find(texture);
+    if (it == index_of.end()) return; // Not used by any mesh
+    auto& entry = entries[it->second];
+    entry.min_lod = static_cast<float>(level);
+    glNamedBufferSubData(SSBO, it->second * sizeof(Entry), sizeof(Entry), &entry);
+}
+
+bool TextureTable::Reduce(int index, int max_size)
+{
+    if (!is_bindless) return false; // Layers of an array share its storage
+
+    GLuint texture = textures[index];
+    GLint width, height, format, levels;
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    GLint first = 0;
+    while (first + 1 < levels && std::max(width >> first, height >> first) > max_size) first++;
+    if (first == 0) return false;
+
+    // GPU side copy of the coarse levels, the same as TextureStreamer keeps resident
+    GLuint reduced;
+    glCreateTextures(GL_TEXTURE_2D, 1, &reduced);
+    glTextureStorage2D(reduced, levels - first, format, std::max(1, width >> first), std::max(1, height >> first));
+    for (GLint level = first; level < levels; level++) {
+        glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0,
+            reduced, GL_TEXTURE_2D, level - first, 0, 0, 0,
+            std::max(1, width >> level), std::max(1, height >> level), 1);
+    }
+    glTextureParameteri(reduced, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(reduced, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(reduced, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(reduced, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    Replace(index, reduced, 0);
+    print("TextureTable: texture " << index << " reduced to " << (width >> first) << "x" << (height >> first));
+    return true;
+}
+
+void TextureTable::Restore(int index, CookedTexture& cooked, TextureStreamer& streamer)
+{
+    if (!is_bindless) return;
+
+    int first = TextureStreamer::GetResidentLevel(cooked);
+    GLuint texture = TextureUpload(cooked, first);
+    streamer.Queue(keys[index], cooked);
+    streamer.Retarget(keys[index], texture, -1);
+    Replace(index, texture, first);
+    print("TextureTable: texture " << index << " restored, streaming from level " << first);
+}
+
+void TextureTable::Replace(int index, GLuint texture, int min_level)
+{
+    // Draws issued so far may still sample the old one
+    auto& entry = entries[index];
+    retired.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), entry.handle, textures[index] });
+
+    entry.handle = glGetTextureHandleARB(texture);
+    glMakeTextureHandleResidentARB(entry.handle);
+    entry.min_lod = static_cast<float>(min_level);
+    glNamedBufferSubData(SSBO, index * sizeof(Entry), sizeof(Entry), &entry);
+    textures[index] = texture;
+    sizes[index] = GetStorageBytes(texture);
+}
+
+void TextureTable::Release(const Retired& old)
+{
+    glDeleteSync(old.fence);
+    glMakeTextureHandleNonResidentARB(old.handle);
+    glDeleteTextures(1, &old.texture);
+}
+
+void TextureTable::Clear()
+{
+    for (const auto& old : retired) {
+        Release(old);
+    }
+    retired.clear();
+    if (is_bindless) {
+        for (const auto& entry : entries) {
+            if (entry.handle) glMakeTextureHandleNonResidentARB(entry.handle);
+        }
+    }
+    entries.clear();
+    index_of.clear();
+    keys.clear();
+    sizes.clear();
+    glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    textures.clear();
+    glDeleteTextures(static_cast<GLsizei>(arrays.size()), arrays.data());
+    arrays.clear();
+    glDeleteBuffers(1, &SSBO);
+    SSBO = 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+#include "TextureStreamer.hpp"
+
+#define TEXTURE_TABLE_MAX_ARRAYS 14 // Fallback without bindless textures: max. number of different (size, format) groups; GL guarantees 16 samplers, VirtualTexture takes 2
+#define TEXTURE_TABLE_BINDING 3     // SSBO binding point of the table
+
+// All textures of the scene in one table, draws only set an index into it (u_texture_index) and never bind textures
+// - GL_ARB_bindless_texture: table holds resident texture handles
+// - otherwise textures are packed into texture arrays by size and format, table holds (array, layer)
+// - every entry has the finest mip level that may be sampled (levels are still being streamed in)
+// - bindless textures can be replaced by a copy with coarse levels only and restored later (ResidencyManager)
+class TextureTable
+{
+public:
+    void Build(const std::vector<Mesh*>& meshes, TextureStreamer& streamer); // After all models are loaded; sets texture_index of the meshes
+    void Bind(ShaderProgram& shader);                                        // Every frame, shader must be active
+    void SetMinLevel(GLuint texture, int level);                             // texture = id the mesh had before Build()
+    void Clear();
+
+    bool IsBindless() const { return is_bindless; }
+    int GetTextureCount() const { return static_cast<int>(keys.size()); }
+    GLuint GetTextureKey(int index) const { return keys[index]; }    // Texture id the mesh had before Build()
+    size_t GetTextureBytes(int index) const { return sizes[index]; } // GPU storage of all levels (array: share of one layer)
+
+    // Bindless only: keep just the levels up to max_size, false if there is nothing to drop
+    bool Reduce(int index, int max_size);
+    // Bindless only: full texture again, coarse levels are uploaded now, fine ones streamed (takes them from cooked)
+    void Restore(int index, CookedTexture& cooked, TextureStreamer& streamer);
+private:
+    struct Entry { // std430, TextureEntry in uber.frag
+        GLuint64 handle;
+        GLint array;
+        GLint layer;
+        float min_lod;
+        float padding;
+    };
+    std::vector<Entry> entries;
+    std::map<GLuint, int> index_of; // original texture id -> entry
+    std::vector<GLuint> keys;       // entry -> original texture id
+    std::vector<size_t> sizes;      // entry -> bytes
+
+    bool is_bindless = false;
+    GLuint SSBO{ 0 };
+
+    std::vector<GLuint> textures;  // Bindless: textures owned by the table
+    std::vector<GLuint> arrays;    // Arrays: one texture array per (width, height, format)
+
+    // Replaced bindless textures, released once GPU finished the draws issued before the replacement
+    struct Retired {
+        GLsync fence;
+        GLuint64 handle;
+        GLuint texture;
+    };
+    std::deque<Retired> retired;
+    void Replace(int index, GLuint texture, int min_level);
+    void Release(const Retired& old);
+};
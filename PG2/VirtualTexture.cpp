@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+#include "VirtualTexture.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+bool VirtualTexture::Init(Model* heightmap, const std::filesystem::path& heights_path, const std::filesystem::path& tiles_path)
+{
+    PROFILE_ZONE("VirtualTexture::Init");
+    if (!GLEW_EXT_texture_compression_s3tc) {
+        std::cerr << "VirtualTexture: BC1 not supported, heightmap keeps its tilemap\n";
+        return false;
+    }
+    this->heightmap = heightmap;
+
+    // Levels down to a single page
+    n_levels = 0;
+    n_pages = 0;
+    level_offsets.clear();
+    for (int pages = VIRTUAL_TEXTURE_PAGES; pages > 0; pages /= 2) {
+        level_offsets.push_back(n_pages);
+        n_pages += pages * pages;
+        n_levels++;
+    }
+
+    Image heights = ImageLoad(heights_path, IMAGE_CHANNELS_GRAY);
+    if (heights.IsEmpty()) {
+        std::cerr << "VirtualTexture: No heightmap " << heights_path << "\n";
+        return false;
+    }
+    if (!IsFileValid(heights_path, tiles_path)) {
+        std::cout << "VirtualTexture: Baking " << VIRTUAL_TEXTURE_FILE << "\n";
+        Image tiles = ImageLoad(tiles_path, IMAGE_CHANNELS_RGBA);
+        if (tiles.IsEmpty() || !Bake(heights, tiles)) {
+            std::cerr << "VirtualTexture: Can not bake " << VIRTUAL_TEXTURE_FILE << ", heightmap keeps its tilemap\n";
+            return false;
+        }
+    }
+
+    // Heightmap is not rotated: world x = offset + scale * heightmap pixel x (z the same)
+    const glm::mat4& mx = heightmap->GetModelMatrix();
+    world_to_uv = glm::vec4(1.0f / (mx[0][0] * heights.width), 1.0f / (mx[2][2] * heights.height),
+        -mx[3][0] / (mx[0][0] * heights.width), -mx[3][2] / (mx[2][2] * heights.height));
+    texels_per_unit = static_cast<float>(VIRTUAL_TEXTURE_PAGES * VIRTUAL_TEXTURE_PAGE_CONTENT) / (mx[0][0] * heights.width);
+
+    // Bounding spheres of the finest pages, heights of the part of the heightmap they cover
+    page_bounds.clear();
+    for (int y = 0; y < VIRTUAL_TEXTURE_PAGES; y++) {
+        for (int x = 0; x < VIRTUAL_TEXTURE_PAGES; x++) {
+            int x0 = x * heights.width / VIRTUAL_TEXTURE_PAGES, x1 = std::min((x + 1) * heights.width / VIRTUAL_TEXTURE_PAGES, heights.width - 1);
+            int z0 = y * heights.height / VIRTUAL_TEXTURE_PAGES, z1 = std::min((y + 1) * heights.height / VIRTUAL_TEXTURE_PAGES, heights.height - 1);
+            int h_min = 255, h_max = 0;
+            for (int z = z0; z <= z1; z++) {
+                for (int px = x0; px <= x1; px++) {
+                    h_min = std::min(h_min, static_cast<int>(heights.At(px, z)));
+                    h_max = std::max(h_max, static_cast<int>(heights.At(px, z)));
+                }
+            }
+            glm::vec3 size(x1 - x0, h_max - h_min, z1 - z0);
+            glm::vec3 center = mx * glm::vec4((x0 + x1) / 2.0f, (h_min + h_max) / 2.0f, (z0 + z1) / 2.0f, 1.0f);
+            page_bounds.push_back(glm::vec4(center, glm::length(size) / 2.0f * mx[0][0]));
+        }
+    }
+
+    // Cache of pages and the table pointing into it
+    int cache_size = VIRTUAL_TEXTURE_CACHE_PAGES * VIRTUAL_TEXTURE_PAGE_SIZE;
+    glCreateTextures(GL_TEXTURE_2D, 1, &cache);
+    glTextureStorage2D(cache, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, cache_size, cache_size);
+    glTextureParameteri(cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glCreateTextures(GL_TEXTURE_2D, 1, &page_table);
+    glTextureStorage2D(page_table, n_levels, GL_RGBA8UI, VIRTUAL_TEXTURE_PAGES, VIRTUAL_TEXTURE_PAGES);
+    glTextureParameteri(page_table, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(page_table, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    page_table_levels.resize(n_levels);
+    for (int level = 0; level < n_levels; level++) {
+        int pages = VIRTUAL_TEXTURE_PAGES >> level;
+        page_table_levels[level].assign(static_cast<size_t>(pages) * pages, 0);
+    }
+
+    slots.assign(VIRTUAL_TEXTURE_CACHE_PAGES * VIRTUAL_TEXTURE_CACHE_PAGES, Slot());
+    slot_of.assign(n_pages, -1);
+    needed_frames.assign(n_pages, 0);
+    is_loading.assign(n_pages, 0);
+    resident_count = 0;
+
+    // Coarsest page stays, every lookup ends there at worst
+    FileHeader header;
+    std::vector<unsigned char> data(header.page_bytes);
+    std::ifstream file(VIRTUAL_TEXTURE_FILE, std::ios::binary);
+    file.seekg(sizeof(FileHeader) + static_cast<std::streamoff>(n_pages - 1) * header.page_bytes);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        std::cerr << "VirtualTexture: Can not read " << VIRTUAL_TEXTURE_FILE << ", heightmap keeps its tilemap\n";
+        Clear();
+        return false;
+    }
+    Upload(n_pages - 1, data);
+    UpdatePageTable();
+
+    is_loader_running = true;
+    loader = std::thread(&VirtualTexture::Load, this);
+
+    tilemap_index = heightmap->GetMesh().texture_index;
+    SetEnabled(true);
+    print("VirtualTexture: " << VIRTUAL_TEXTURE_PAGES * VIRTUAL_TEXTURE_PAGE_CONTENT << " texels, " << n_levels << " levels, " << n_pages << " pages");
+    return true;
+}
+
+bool VirtualTexture::IsFileValid(const std::filesystem::path& heights_path, const std::filesystem::path& tiles_path) const
+{
+    // Newer than both sources, same layout
+    std::filesystem::path path(VIRTUAL_TEXTURE_FILE);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)
+        || std::filesystem::last_write_time(path, ec) < std::filesystem::last_write_time(heights_path, ec)
+        || std::filesystem::last_write_time(path, ec) < std::filesystem::last_write_time(tiles_path, ec) || ec) {
+        return false;
+    }
+    FileHeader header, expected;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        return false;
+    }
+    return std::filesystem::file_size(path, ec) == sizeof(FileHeader) + static_cast<uintmax_t>(n_pages) * expected.page_bytes && !ec;
+}
+
+void VirtualTexture::SetEnabled(bool is_enabled)
+{
+    if (!IsAvailable()) return;
+    heightmap->GetMesh().texture_index = is_enabled ? VIRTUAL_TEXTURE_INDEX : tilemap_index;
+}
+
+void VirtualTexture::Update(const glm::mat4& mx_view_projection, const glm::vec3& camera_position, float fov_y, int viewport_height)
+{
+    PROFILE_ZONE("VirtualTexture::Update");
+    if (!IsAvailable() || heightmap->GetMesh().texture_index != VIRTUAL_TEXTURE_INDEX) return;
+    frame++;
+
+    // Arrived pages; queue is built again below from what is missing now
+    std::vector<std::pair<int, std::vector<unsigned char>>> arrived;
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        size_t n = std::min(loaded.size(), static_cast<size_t>(VIRTUAL_TEXTURE_UPLOADS));
+        std::move(loaded.begin(), loaded.begin() + n, std::back_inserter(arrived));
+        loaded.erase(loaded.begin(), loaded.begin() + n);
+        for (int page : load_queue) {
+            is_loading[page] = 0;
+        }
+        load_queue.clear();
+    }
+
+    // Feedback :: visible finest pages, their distance gives the level the shader picks there (texels per pixel)
+    culler.SetFrustum(mx_view_projection);
+    culler.Clear();
+    for (const auto& bounds : page_bounds) {
+        culler.AddSphere(bounds);
+    }
+    culler.Cull();
+    float pixel_size = 2.0f * std::tan(glm::radians(fov_y) / 2.0f) / viewport_height; // Per unit of distance
+    missing.clear();
+    needed_count = 0;
+    for (int y = 0; y < VIRTUAL_TEXTURE_PAGES; y++) {
+        for (int x = 0; x < VIRTUAL_TEXTURE_PAGES; x++) {
+            size_t i = static_cast<size_t>(y) * VIRTUAL_TEXTURE_PAGES + x;
+            if (!culler.IsVisible(i)) continue;
+            glm::vec3 center(page_bounds[i]);
+            float center_distance = std::max(glm::distance(camera_position, center), 0.01f);
+            float distance = std::max(center_distance - page_bounds[i].w, 0.01f);
+            // Terrain seen at a grazing angle is minified more, shader takes the bigger of the two derivatives
+            float cos_angle = std::clamp(std::abs(camera_position.y - center.y) / center_distance, 1.0f / 16.0f, 1.0f);
+            float lod = std::log2(distance * pixel_size * texels_per_unit / cos_angle);
+            int level = std::clamp(static_cast<int>(std::floor(lod + 0.5f)), 0, n_levels - 1);
+            Request(level, x >> level, y >> level);
+            if (level + 1 < n_levels) Request(level + 1, x >> (level + 1), y >> (level + 1)); // Estimate may be off by one, parent is cheap
+        }
+    }
+
+    for (const auto& [page, data] : arrived) {
+        Upload(page, data);
+    }
+
+    // Coarse pages first (they have the higher ids), whole areas get sharper evenly
+    std::sort(missing.begin(), missing.end(), std::greater<int>());
+    if (missing.size() > VIRTUAL_TEXTURE_LOADS) missing.resize(VIRTUAL_TEXTURE_LOADS);
+    if (!missing.empty()) {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        for (int page : missing) {
+            load_queue.push_back(page);
+            is_loading[page] = 1;
+        }
+    }
+    loader_condition.notify_one();
+
+    if (is_page_table_dirty) UpdatePageTable();
+    print("VirtualTexture: " << needed_count << " pages needed, " << resident_count << " resident, " << missing.size() << " queued");
+}
+
+void VirtualTexture::Request(int level, int x, int y)
+{
+    int page = GetPageId(level, x, y);
+    if (needed_frames[page] == frame) return;
+    needed_frames[page] = frame;
+    needed_count++;
+    if (slot_of[page] >= 0) slots[slot_of[page]].last_used = frame;
+    else if (!is_loading[page]) missing.push_back(page);
+}
+
+void VirtualTexture::Upload(int page, const std::vector<unsigned char>& data)
+{
+    is_loading[page] = 0;
+    if (slot_of[page] >= 0 || data.empty()) return;
+
+    // Free slot, or the least recently used one that is not needed this frame
+    int best = -1;
+    for (int i = 0; i < static_cast<int>(slots.size()); i++) {
+        if (slots[i].page < 0) {
+            best = i;
+            break;
+        }
+        if (slots[i].page == n_pages - 1) continue; // Coarsest page stays
+        if (slots[i].last_used < frame && (best < 0 || slots[i].last_used < slots[best].last_used)) best = i;
+    }
+    if (best < 0) return; // Everything in the cache is needed, page is requested again later
+    if (slots[best].page >= 0) {
+        slot_of[slots[best].page] = -1;
+        resident_count--;
+    }
+    slots[best] = { page, needed_frames[page] };
+    slot_of[page] = best;
+    resident_count++;
+
+    int slot_x = best % VIRTUAL_TEXTURE_CACHE_PAGES, slot_y = best / VIRTUAL_TEXTURE_CACHE_PAGES;
+    glCompressedTextureSubImage2D(cache, 0, slot_x * VIRTUAL_TEXTURE_PAGE_SIZE, slot_y * VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_PAGE_SIZE,
+        GL_COMPRESSED_RGB_S3TC_DXT1_EXT, static_cast<GLsizei>(data.size()), data.data());
+    is_page_table_dirty = true;
+}
+
+void VirtualTexture::UpdatePageTable()
+{
+    // Coarse to fine: page that is not resident inherits the entry of its parent
+    for (int level = n_levels - 1; level >= 0; level--) {
+        int pages = VIRTUAL_TEXTURE_PAGES >> level;
+        auto& entries = page_table_levels[level];
+        for (int y = 0; y < pages; y++) {
+            for (int x = 0; x < pages; x++) {
+                int slot = slot_of[GetPageId(level, x, y)];
+                uint32_t& entry = entries[static_cast<size_t>(y) * pages + x];
+                if (slot >= 0) {
+                    // RGBA8UI: slot x, slot y, level
+                    entry = static_cast<uint32_t>(slot % VIRTUAL_TEXTURE_CACHE_PAGES) | static_cast<uint32_t>(slot / VIRTUAL_TEXTURE_CACHE_PAGES) << 8
+                        | static_cast<uint32_t>(level) << 16 | 0xFF000000u;
+                }
+                else {
+                    entry = level + 1 < n_levels ? page_table_levels[level + 1][static_cast<size_t>(y / 2) * (pages / 2) + x / 2] : 0;
+                }
+            }
+        }
+        glTextureSubImage2D(page_table, level, 0, 0, pages, pages, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+    }
+    is_page_table_dirty = false;
+}
+
+void VirtualTexture::Bind(ShaderProgram& shader)
+{
+    if (!IsAvailable()) return;
+
+    // Units may have been used by others (OIT composite), bind every frame
+    glBindTextureUnit(VIRTUAL_TEXTURE_UNIT, page_table);
+    glBindTextureUnit(VIRTUAL_TEXTURE_UNIT + 1, cache);
+    shader.SetUniform("u_vt_transform", world_to_uv);
+    shader.SetUniform("u_vt_pages", VIRTUAL_TEXTURE_PAGES);
+    shader.SetUniform("u_vt_levels", n_levels);
+}
+
+void VirtualTexture::Load()
+{
+    PROFILE_THREAD("Virtual texture loader");
+    // Own stream, main thread never waits for the disk
+    FileHeader header;
+    std::ifstream file(VIRTUAL_TEXTURE_FILE, std::ios::binary);
+    while (true) {
+        int page;
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex);
+            loader_condition.wait(lock, [this]() { return !load_queue.empty() || !is_loader_running; });
+            if (!is_loader_running) return;
+            page = load_queue.front();
+            load_queue.pop_front();
+        }
+        PROFILE_ZONE("VirtualTexture::Load page");
+
+        std::vector<unsigned char> data(header.page_bytes);
+        file.seekg(sizeof(FileHeader) + static_cast<std::streamoff>(page) * header.page_bytes);
+        if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+            std::cerr << "VirtualTexture: Can not read page " << page << "\n";
+            file.clear();
+            data.clear(); // Main thread only marks it as not loading
+        }
+
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        loaded.push_back({ page, std::move(data) });
+    }
+}
+
+void VirtualTexture::Clear()
+{
+    if (loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(loader_mutex);
+            is_loader_running = false;
+        }
+        loader_condition.notify_all();
+        loader.join();
+    }
+    load_queue.clear();
+    loaded.clear();
+
+    glDeleteTextures(1, &cache);
+    cache = 0;
+    glDeleteTextures(1, &page_table);
+    page_table = 0;
+    page_table_levels.clear();
+    slots.clear();
+    slot_of.clear();
+    needed_frames.clear();
+    is_loading.clear();
+    page_bounds.clear();
+    resident_count = 0;
+    heightmap = nullptr;
+}
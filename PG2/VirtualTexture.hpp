@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.hpp"
+#include "Image.hpp"
+#include "Model.hpp"
+#include "ShaderProgram.hpp"
+#include "TextureCooker.hpp"
+
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128   // Texels of a page in the cache, border included (multiple of 4, BC1 blocks)
+#define VIRTUAL_TEXTURE_BORDER 4        // Texels of the neighbouring pages on each side, bilinear filtering never leaves the page
+#define VIRTUAL_TEXTURE_PAGE_CONTENT (VIRTUAL_TEXTURE_PAGE_SIZE - 2 * VIRTUAL_TEXTURE_BORDER)
+#define VIRTUAL_TEXTURE_PAGES 64        // Pages per side of the finest level, coarser levels halve it down to 1 (64 * 120 = 7680 texels)
+#define VIRTUAL_TEXTURE_CACHE_PAGES 32  // Cache texture holds N*N pages (BC1: 4096x4096 = 8 MB, whatever the virtual size is)
+#define VIRTUAL_TEXTURE_UPLOADS 16      // Pages uploaded to the cache per frame at most
+#define VIRTUAL_TEXTURE_LOADS 64        // Pages waiting for the loader thread at most
+#define VIRTUAL_TEXTURE_UNIT 14         // Texture unit of the page table, cache uses the next one (TextureTable arrays use 0..13)
+#define VIRTUAL_TEXTURE_INDEX -2        // Mesh::texture_index of the virtually textured mesh, uber.frag samples the virtual texture then
+#define VIRTUAL_TEXTURE_FILE TEXTURE_CACHE_DIR "/terrain.vt"
+
+// Software virtual texturing of the heightmap: one unique texture of the whole terrain at constant GPU memory
+// - the texture is baked once from the heightmap and its tilemap into a file of BC1 pages (mip levels included), see VirtualTextureBake.cpp
+// - feedback is estimated on CPU: visible parts of the terrain (frustum) and their distance give the level of the pages needed
+// - a loader thread reads the missing pages from the file, coarse ones first; they are uploaded into free or least recently used cache slots
+// - page table texture (mip level per virtual level) points every page to the cache slot of the finest resident page covering it
+// - the coarsest page always stays in the cache, so anything can be drawn, just blurry until finer pages arrive
+class VirtualTexture
+{
+public:
+    // After TextureTable::Build(); false if it is not supported (BC1), heightmap keeps its tilemap texture then
+    bool Init(Model* heightmap, const std::filesystem::path& heights_path, const std::filesystem::path& tiles_path);
+    // Every frame after the camera moved; finds the pages needed, uploads loaded ones, updates the page table
+    void Update(const glm::mat4& mx_view_projection, const glm::vec3& camera_position, float fov_y, int viewport_height);
+    void Bind(ShaderProgram& shader); // Every frame, shader must be active
+    void SetEnabled(bool is_enabled); // Heightmap uses the virtual texture, or its tilemap again
+    void Clear();
+
+    bool IsAvailable() const { return cache != 0; }
+    int GetResidentCount() const { return resident_count; }
+    int GetNeededCount() const { return needed_count; }
+private:
+    Model* heightmap = nullptr;
+    int tilemap_index = -1; // Texture index of the heightmap in TextureTable
+
+    // Pages of all levels, id = level_offsets[level] + y * (VIRTUAL_TEXTURE_PAGES >> level) + x
+    int n_levels = 0;
+    int n_pages = 0;
+    std::vector<int> level_offsets;
+    int GetPageId(int level, int x, int y) const { return level_offsets[level] + y * (VIRTUAL_TEXTURE_PAGES >> level) + x; }
+
+    // Tiled file
+    struct FileHeader {
+        char magic[4] = { 'P', 'G', 'V', 'T' };
+        uint32_t page_size = VIRTUAL_TEXTURE_PAGE_SIZE;
+        uint32_t border = VIRTUAL_TEXTURE_BORDER;
+        uint32_t pages = VIRTUAL_TEXTURE_PAGES;
+        uint32_t format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        uint32_t page_bytes = VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE / 2;
+    };
+    bool IsFileValid(const std::filesystem::path& heights_path, const std::filesystem::path& tiles_path) const;
+    bool Bake(const Image& heights, const Image& tiles) const; // VirtualTextureBake.cpp
+
+    // GPU
+    GLuint cache{ 0 };      // VIRTUAL_TEXTURE_CACHE_PAGES^2 slots of pages, no mip levels
+    GLuint page_table{ 0 }; // GL_RGBA8UI: cache slot x, y, level of the page there
+    std::vector<std::vector<uint32_t>> page_table_levels;
+    bool is_page_table_dirty = true;
+    glm::vec4 world_to_uv{}; // Heightmap world xz -> virtual texture uv: xy scale, zw offset
+    float texels_per_unit = 0.0f; // Finest level texels per world unit
+
+    // Cache slots, least recently used ones are reused
+    struct Slot {
+        int page = -1;
+        uint64_t last_used = 0;
+    };
+    std::vector<Slot> slots;
+    std::vector<int> slot_of;             // Page id -> slot, -1 = not resident
+    std::vector<uint64_t> needed_frames;  // Page id -> last frame it was needed
+    std::vector<unsigned char> is_loading;
+    std::vector<int> missing;             // Reused every frame
+    uint64_t frame = 0;
+    int resident_count = 0;
+    int needed_count = 0;
+    void Request(int level, int x, int y);
+    void Upload(int page, const std::vector<unsigned char>& data);
+    void UpdatePageTable();
+
+    // CPU feedback: bounding spheres of the finest level pages over the heightmap
+    FrustumCuller culler;
+    std::vector<glm::vec4> page_bounds;
+
+    // Loader thread
+    std::thread loader;
+    std::mutex loader_mutex;
+    std::condition_variable loader_condition;
+    std::deque<int> load_queue;                                      // Coarse pages first
+    std::vector<std::pair<int, std::vector<unsigned char>>> loaded; // Waiting for upload
+    bool is_loader_running = false;
+    void Load();
+};
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <thread>
+
+#include "VirtualTexture.hpp"
+#include "Profiler.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+//
+// Terrain texture of VirtualTexture, baked from the heightmap and its tilemap (there is no huge source image)
+// - every texel gets the subtexture HeightMap_Load() puts on its tile, sampled from the matching tilemap mip level
+// - slopes are darkened by the heightmap normals, so no two parts of the terrain look the same
+// - coarser levels are supersampled, one texel covers several tiles there
+//
+
+// RGB of RGBA image, bilinear, clamped at the edges; x, y in pixels
+static glm::vec3 SampleBilinear(const Image& image, float x, float y)
+{
+    x = std::clamp(x - 0.5f, 0.0f, image.width - 1.0f);
+    y = std::clamp(y - 0.5f, 0.0f, image.height - 1.0f);
+    int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, image.width - 1), y1 = std::min(y0 + 1, image.height - 1);
+    auto at = [&image](int px, int py) {
+        const unsigned char* pixel = image.Row(py) + 4 * px;
+        return glm::vec3(pixel[0], pixel[1], pixel[2]);
+    };
+    return glm::mix(glm::mix(at(x0, y0), at(x1, y0), x - x0), glm::mix(at(x0, y1), at(x1, y1), x - x0), y - y0);
+}
+
+// Grid of one value per heightmap pixel, the same way
+static float SampleBilinear(const std::vector<float>& grid, int width, int height, float x, float y)
+{
+    x = std::clamp(x, 0.0f, width - 1.0f);
+    y = std::clamp(y, 0.0f, height - 1.0f);
+    int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+    auto at = [&](int px, int py) { return grid[static_cast<size_t>(py) * width + px]; };
+    return glm::mix(glm::mix(at(x0, y0), at(x1, y0), x - x0), glm::mix(at(x0, y1), at(x1, y1), x - x0), y - y0);
+}
+
+bool VirtualTexture::Bake(const Image& heights, const Image& tiles) const
+{
+    PROFILE_ZONE("VirtualTexture::Bake");
+    const int step = HEIGHTMAP_STEP;
+    const int width = heights.width, height = heights.height;
+
+    // Tiles of the mesh and their subtextures, chosen by the max. height of the corners as HeightMap_Load() does
+    int tiles_x = (width - 1) / step, tiles_z = (height - 1) / step;
+    if (tiles_x < 1 || tiles_z < 1) return false;
+    std::vector<glm::vec2> subtextures(static_cast<size_t>(tiles_x) * tiles_z);
+    for (int tz = 0; tz < tiles_z; tz++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            int x = tx * step, z = tz * step;
+            int max_h = std::max({ heights.At(x, z), heights.At(x, z + step), heights.At(x + step, z + step), heights.At(x + step, z) });
+            subtextures[static_cast<size_t>(tz) * tiles_x + tx] = Model::HeightMap_GetSubtexByHeight(max_h / 255.0f);
+        }
+    }
+
+    // Slope shading: y of the heightmap normal (heights are in the same units as pixels)
+    std::vector<float> shades(static_cast<size_t>(width) * height);
+    for (int z = 0; z < height; z++) {
+        for (int x = 0; x < width; x++) {
+            float dx = (heights.At(std::min(x + 1, width - 1), z) - heights.At(std::max(x - 1, 0), z)) / 2.0f;
+            float dz = (heights.At(x, std::min(z + 1, height - 1)) - heights.At(x, std::max(z - 1, 0))) / 2.0f;
+            shades[static_cast<size_t>(z) * width + x] = 0.7f + 0.3f / std::sqrt(1.0f + dx * dx + dz * dz);
+        }
+    }
+
+    // Tilemap mip chain, the level with about one tilemap pixel per sample is used
+    std::vector<Image> tile_levels{ tiles };
+    while (tile_levels.back().width > 1 || tile_levels.back().height > 1) {
+        tile_levels.push_back(TextureDownsample(tile_levels.back()));
+    }
+    float tile_pixels_per_step = tiles.width / 16.0f; // Tilemap has 16x16 subtextures, one per tile
+
+    FileHeader header;
+    std::vector<unsigned char> data(static_cast<size_t>(n_pages) * header.page_bytes);
+    auto bake_page = [&](int page) {
+        int level = static_cast<int>(std::upper_bound(level_offsets.begin(), level_offsets.end(), page) - level_offsets.begin()) - 1;
+        int pages = VIRTUAL_TEXTURE_PAGES >> level;
+        int page_x = (page - level_offsets[level]) % pages, page_y = (page - level_offsets[level]) / pages;
+
+        int n_samples = std::min(1 << level, 4); // Per axis
+        float texels = static_cast<float>(pages * VIRTUAL_TEXTURE_PAGE_CONTENT);
+        float samples_per_step = texels * n_samples / width * step;
+        int tile_level = std::clamp(static_cast<int>(std::floor(std::log2(tile_pixels_per_step / samples_per_step) + 0.5f)), 0, static_cast<int>(tile_levels.size()) - 1);
+        const Image& tile_image = tile_levels[tile_level];
+
+        Image rgba;
+        rgba.width = VIRTUAL_TEXTURE_PAGE_SIZE;
+        rgba.height = VIRTUAL_TEXTURE_PAGE_SIZE;
+        rgba.channels = 4;
+        rgba.pixels.resize(static_cast<size_t>(rgba.width) * rgba.height * 4);
+        for (int j = 0; j < VIRTUAL_TEXTURE_PAGE_SIZE; j++) {
+            for (int i = 0; i < VIRTUAL_TEXTURE_PAGE_SIZE; i++) {
+                // Texel of the level (border reaches into the neighbours) -> heightmap pixels
+                float texel_x = static_cast<float>(page_x * VIRTUAL_TEXTURE_PAGE_CONTENT + i - VIRTUAL_TEXTURE_BORDER);
+                float texel_y = static_cast<float>(page_y * VIRTUAL_TEXTURE_PAGE_CONTENT + j - VIRTUAL_TEXTURE_BORDER);
+                glm::vec3 color(0.0f);
+                for (int sy = 0; sy < n_samples; sy++) {
+                    for (int sx = 0; sx < n_samples; sx++) {
+                        float x = (texel_x + (sx + 0.5f) / n_samples) / texels * width;
+                        float z = (texel_y + (sy + 0.5f) / n_samples) / texels * height;
+                        int tx = std::clamp(static_cast<int>(x) / step, 0, tiles_x - 1);
+                        int tz = std::clamp(static_cast<int>(z) / step, 0, tiles_z - 1);
+                        glm::vec2 local = glm::clamp(glm::vec2(x - tx * step, z - tz * step) / static_cast<float>(step), 0.0f, 1.0f);
+                        glm::vec2 st = subtextures[static_cast<size_t>(tz) * tiles_x + tx] + local / 16.0f;
+                        color += SampleBilinear(tile_image, st.x * tile_image.width, st.y * tile_image.height) * SampleBilinear(shades, width, height, x, z);
+                    }
+                }
+                color /= static_cast<float>(n_samples * n_samples);
+                unsigned char* pixel = rgba.Row(j) + 4 * i;
+                pixel[0] = static_cast<unsigned char>(std::min(color.r + 0.5f, 255.0f));
+                pixel[1] = static_cast<unsigned char>(std::min(color.g + 0.5f, 255.0f));
+                pixel[2] = static_cast<unsigned char>(std::min(color.b + 0.5f, 255.0f));
+                pixel[3] = 255;
+            }
+        }
+        std::vector<unsigned char> blocks = TextureEncode(rgba, header.format);
+        std::copy(blocks.begin(), blocks.end(), data.begin() + static_cast<size_t>(page) * header.page_bytes);
+    };
+
+    // Pages are independent
+    std::atomic<int> next_page{ 0 };
+    int n_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> workers;
+    for (int t = 0; t < n_threads; t++) {
+        workers.push_back(std::async(std::launch::async, [&]() {
+            for (int page = next_page++; page < n_pages; page = next_page++) {
+                bake_page(page);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    std::filesystem::path path(VIRTUAL_TEXTURE_FILE);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    print("VirtualTexture: baked " << n_pages << " pages, " << data.size() / (1024 * 1024) << " MB");
+    return file.good();
+}
@@ -0,0 +1,125 @@
+#include <iostream>
+
+#include "WeightedBlendedOIT.hpp"
+
+#define print(x) //std::cout << x << "\n"
+
+void WeightedBlendedOIT::Init(int width, int height)
+{
+	std::filesystem::path VS_path("./resources/shaders/oit_composite.vert");
+	std::filesystem::path FS_path("./resources/shaders/oit_composite.frag");
+	composite_shader = ShaderProgram(VS_path, FS_path);
+	glGenVertexArrays(1, &empty_VAO);
+
+	this->width = width;
+	this->height = height;
+	CreateTargets();
+}
+
+void WeightedBlendedOIT::Resize(int width, int height)
+{
+	if (width < 1 || height < 1) return; // Minimized window
+	if (width == this->width && height == this->height) return;
+	this->width = width;
+	this->height = height;
+	DeleteTargets();
+	CreateTargets();
+}
+
+void WeightedBlendedOIT::CreateTargets()
+{
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	glGenTextures(1, &accumulation_texture);
+	glBindTexture(GL_TEXTURE_2D, accumulation_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation_texture, 0);
+
+	glGenTextures(1, &revealage_texture);
+	glBindTexture(GL_TEXTURE_2D, revealage_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealage_texture, 0);
+
+	// Same format as default framebuffer, so depth can be blitted
+	glGenRenderbuffers(1, &depth_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+
+	const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, draw_buffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::exception("WeightedBlendedOIT: Framebuffer incomplete\n");
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	print("WeightedBlendedOIT: targets " << width << "x" << height);
+}
+
+void WeightedBlendedOIT::Begin()
+{
+	// Opaque depth: scene framebuffer -> OIT framebuffer
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &scene_FBO);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_FBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+	const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat one[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_COLOR, 1, one);
+
+	// Order independent blending
+	glEnable(GL_BLEND);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	glDepthMask(GL_FALSE);
+}
+
+void WeightedBlendedOIT::End()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, scene_FBO);
+
+	// Composite over opaque scene
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+	composite_shader.Activate();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, accumulation_texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, revealage_texture);
+	composite_shader.SetUniform("u_accumulation", 0);
+	composite_shader.SetUniform("u_revealage", 1);
+	glBindVertexArray(empty_VAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Back to defaults
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void WeightedBlendedOIT::DeleteTargets()
+{
+	if (FBO) { glDeleteFramebuffers(1, &FBO); FBO = 0; }
+	if (accumulation_texture) { glDeleteTextures(1, &accumulation_texture); accumulation_texture = 0; }
+	if (revealage_texture) { glDeleteTextures(1, &revealage_texture); revealage_texture = 0; }
+	if (depth_renderbuffer) { glDeleteRenderbuffers(1, &depth_renderbuffer); depth_renderbuffer = 0; }
+}
+
+void WeightedBlendedOIT::Clear()
+{
+	DeleteTargets();
+	if (empty_VAO) { glDeleteVertexArrays(1, &empty_VAO); empty_VAO = 0; }
+	composite_shader.Clear();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "ShaderProgram.hpp"
+
+// Weighted blended order-independent transparency
+// https://jcgt.org/published/0002/02/09/
+// - transparent objects are drawn in any order into accumulation and revealage targets
+// - composite pass blends the result over the opaque scene in the framebuffer bound before Begin() (default or offscreen)
+class WeightedBlendedOIT
+{
+public:
+    WeightedBlendedOIT() = default;
+
+    void Init(int width, int height); // Valid GL context must exist
+    void Resize(int width, int height);
+    void Begin();                     // Bind targets, copy opaque depth; draw transparent objects after this with u_oit = 1
+    void End();                       // Composite onto the scene framebuffer
+    void Clear();
+
+    ShaderProgram& GetCompositeShader() { return composite_shader; } // for hot reload
+private:
+    int width = 0;
+    int height = 0;
+
+    // OpenGL IDs, 0 == uninitialized
+    GLuint FBO{ 0 };
+    GLuint accumulation_texture{ 0 }; // RGBA16F: sum of premultiplied weighted colors, sum of weighted alphas
+    GLuint revealage_texture{ 0 };    // R8: product of (1 - alpha)
+    GLuint depth_renderbuffer{ 0 };   // Copy of opaque depth, so transparent objects are hidden behind opaque ones
+    GLuint empty_VAO{ 0 };            // Fullscreen triangle is generated in vertex shader, but core profile needs some VAO bound
+    GLint scene_FBO{ 0 };             // Bound when Begin() was called, composited onto in End()
+
+    ShaderProgram composite_shader;
+
+    void CreateTargets();
+    void DeleteTargets();
+};
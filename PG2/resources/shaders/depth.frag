@@ -0,0 +1,6 @@
+#version 450 core
+
+// Depth pre-pass, only depth is written
+void main()
+{
+}
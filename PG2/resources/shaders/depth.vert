@@ -0,0 +1,18 @@
+#version 450 core
+
+// Depth pre-pass, position must be computed exactly as in uber.vert
+
+// Vertex attributes
+layout (location = 0) in vec4 a_position;
+
+// Matrices
+uniform mat4 u_mx_model;            // Object local coor space -> World space
+uniform mat4 u_mx_view_projection;  // World space -> Screen
+
+invariant gl_Position;
+
+void main()
+{
+    vec4 world_position = u_mx_model * a_position;
+    gl_Position = u_mx_view_projection * world_position;
+}
@@ -0,0 +1,23 @@
+#version 450 core
+
+// Weighted blended OIT resolve, https://jcgt.org/published/0002/02/09/
+
+// CPP -> FS
+uniform sampler2D u_accumulation;
+uniform sampler2D u_revealage;
+
+// FS ->
+out vec4 frag_color;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(u_revealage, texel, 0).r;
+    if (revealage == 1.0f) discard; // Nothing transparent here
+
+    vec4 accumulation = texelFetch(u_accumulation, texel, 0);
+    vec3 average_color = accumulation.rgb / max(accumulation.a, 0.00001f);
+
+    // Blended with (1 - alpha, alpha), so alpha is the revealage
+    frag_color = vec4(average_color, revealage);
+}
@@ -1,7 +1,16 @@
-#version 460 core
+#version 450 core
 
 // Inspired by "lighting_dir_point_spot.frag" by Steve Jones, Game Institute
 
+// Permutation, defines are injected by ShaderProgram (see App::GetUberShader)
+// - FLASHLIGHT      spotlight is on
+// - TEXTURED        sample texture u_texture_index of TextureTable, otherwise white; VIRTUAL_TEXTURE_INDEX samples VirtualTexture
+// - BINDLESS        TextureTable holds bindless handles, otherwise (array, layer) of TEXTURE_TABLE_MAX_ARRAYS texture arrays
+// - CLUSTERS_X/Y/Z  light cluster grid (ClusteredLights.hpp)
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
 // VS -> FS
 in vec3 o_fragment_position;
 in vec3 o_normal;
@@ -11,19 +20,75 @@ in vec2 o_texture_coordinate;
 uniform vec3 u_camera_position;
 uniform float u_ambient_alpha;
 uniform float u_diffuse_alpha;
+uniform int u_oit; // 1 == weighted blended order-independent transparency pass
 
 // FS ->
-out vec4 frag_color;
+layout (location = 0) out vec4 frag_color;  // color; or OIT accumulation
+layout (location = 1) out float frag_reveal; // OIT revealage
 
 // Material
 struct Material 
 {
     vec3 ambient;
-    sampler2D textura; // texture unit
     vec3 specular;
     float shininess;
 };
 uniform Material u_material;
+vec4 albedo; // Texture is sampled only once, in main()
+
+// === Textures :: TextureTable (SSBO binding 3), draws only set the index ===
+#ifdef TEXTURED
+uniform int u_texture_index;
+struct TextureEntry
+{
+	uvec2 handle;  // bindless
+	int array;     // texture arrays
+	int layer;
+	float min_lod; // finer levels are still being streamed in
+	float padding;
+};
+layout (std430, binding = 3) readonly buffer Textures { TextureEntry textures[]; };
+#ifndef BINDLESS
+uniform sampler2DArray u_texture_arrays[TEXTURE_TABLE_MAX_ARRAYS];
+#endif
+vec4 sampleTexture(vec2 uv)
+{
+	TextureEntry entry = textures[u_texture_index];
+#ifdef BINDLESS
+	sampler2D sampler = sampler2D(entry.handle);
+	return textureLod(sampler, uv, max(textureQueryLod(sampler, uv).y, entry.min_lod));
+#else
+	float lod = max(textureQueryLod(u_texture_arrays[entry.array], uv).y, entry.min_lod);
+	return textureLod(u_texture_arrays[entry.array], vec3(uv, entry.layer), lod);
+#endif
+}
+
+// === Virtual texture :: heightmap (VirtualTexture), pages of one huge texture in a cache ===
+// Page table has a mip level per virtual level, its texels point to the cache slot of the finest resident page covering them
+layout (binding = VIRTUAL_TEXTURE_UNIT) uniform usampler2D u_vt_page_table;
+layout (binding = VIRTUAL_TEXTURE_UNIT + 1) uniform sampler2D u_vt_cache;
+uniform vec4 u_vt_transform; // World xz -> virtual uv: xy scale, zw offset
+uniform int u_vt_pages;      // Pages per side of the finest level
+uniform int u_vt_levels;
+const int VT_PAGE_CONTENT = VIRTUAL_TEXTURE_PAGE_SIZE - 2 * VIRTUAL_TEXTURE_BORDER;
+vec4 sampleVirtualTexture(vec3 world_position)
+{
+	vec2 uv = clamp(world_position.xz * u_vt_transform.xy + u_vt_transform.zw, 0.0f, 0.99999f);
+
+	// Level from screen space derivatives of the finest level texels, as textureQueryLod() would do
+	vec2 texel = uv * float(u_vt_pages * VT_PAGE_CONTENT);
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float lod = 0.5f * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8f));
+	int level = clamp(int(floor(lod + 0.5f)), 0, u_vt_levels - 1);
+
+	// xy = cache slot, z = level of the page in it (coarser if the wanted one is not loaded yet)
+	uvec4 entry = texelFetch(u_vt_page_table, ivec2(uv * float(u_vt_pages >> level)), level);
+	vec2 in_page = fract(uv * float(u_vt_pages >> int(entry.z)));
+	vec2 cache_texel = vec2(entry.xy) * float(VIRTUAL_TEXTURE_PAGE_SIZE) + float(VIRTUAL_TEXTURE_BORDER) + in_page * float(VT_PAGE_CONTENT);
+	return textureLod(u_vt_cache, cache_texel / float(VIRTUAL_TEXTURE_CACHE_PAGES * VIRTUAL_TEXTURE_PAGE_SIZE), 0.0f);
+}
+#endif
 
 // === Directional light ===
 struct DirectionalLight
@@ -36,38 +101,49 @@ uniform DirectionalLight u_directional_light;
 vec4 calcDirectionalLightColor(DirectionalLight directional_light, vec3 normal, vec3 frag2camera)
 {
 	vec3 frag2light = normalize(-directional_light.direction);
-    vec4 diffuse = vec4(directional_light.diffuse * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * texture(u_material.textura, o_texture_coordinate);
+    vec4 diffuse = vec4(directional_light.diffuse * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * albedo;
 	vec3 specular = directional_light.specular * u_material.specular * pow(max(dot(normal, normalize(frag2light + frag2camera)), 0.0f), u_material.shininess);
 	return (diffuse + vec4(specular, 0.0f));
 }
 
-// === Point lights ===
-#define MAX_POINT_LIGHTS 1
+// === Point lights :: clustered ===
+// Filled by ClusteredLights every frame, fragment evaluates only lights of its cluster
 struct PointLight
 {
-	vec3 position;
-	vec3 diffuse;
-	vec3 specular;
-	int on;
-
-	float constant;
-	float linear;
-	float exponent;
+	vec4 position_radius;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 attenuation; // constant, linear, exponent
 };
-uniform PointLight u_point_lights[MAX_POINT_LIGHTS];
+layout (std430, binding = 0) readonly buffer Lights { PointLight lights[]; };
+layout (std430, binding = 1) readonly buffer Clusters { uvec2 clusters[]; }; // offset, count into light_indices
+layout (std430, binding = 2) readonly buffer LightIndices { uint light_indices[]; };
+uniform vec3 u_cluster_scale; // xy: clusters per pixel, z: slices per log(depth / near)
+uniform float u_near;
+uniform float u_far;
+uint getCluster()
+{
+	float z_ndc = gl_FragCoord.z * 2.0f - 1.0f;
+	float depth = 2.0f * u_near * u_far / (u_far + u_near - z_ndc * (u_far - u_near));
+	ivec3 cluster = ivec3(gl_FragCoord.xy * u_cluster_scale.xy, log(depth / u_near) * u_cluster_scale.z);
+	cluster = clamp(cluster, ivec3(0), ivec3(CLUSTERS_X - 1, CLUSTERS_Y - 1, CLUSTERS_Z - 1));
+	return (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x;
+}
 vec4 calcPointLightColor(PointLight point_light, vec3 normal, vec3 fragment_position, vec3 frag2camera)
 {
-	vec3 frag2light = normalize(point_light.position - fragment_position);
-    vec4 diffuse = vec4(point_light.diffuse * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * texture(u_material.textura, o_texture_coordinate);
-	vec3 specular = point_light.specular * u_material.specular * pow(max(dot(normal, normalize(frag2light + frag2camera)), 0.0f), u_material.shininess);
-	float d = length(point_light.position - fragment_position);
-	float attenuation = 1.0f / (point_light.constant + point_light.linear * d + point_light.exponent * (d * d));
+	vec3 light_position = point_light.position_radius.xyz;
+	vec3 frag2light = normalize(light_position - fragment_position);
+    vec4 diffuse = vec4(point_light.diffuse.rgb * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * albedo;
+	vec3 specular = point_light.specular.rgb * u_material.specular * pow(max(dot(normal, normalize(frag2light + frag2camera)), 0.0f), u_material.shininess);
+	float d = length(light_position - fragment_position);
+	float attenuation = 1.0f / (point_light.attenuation.x + point_light.attenuation.y * d + point_light.attenuation.z * (d * d));
 	diffuse *= attenuation;
 	specular *= attenuation;
 	return (diffuse + vec4(specular, 0.0f));
 }
 
 // === Spotlight ===
+#ifdef FLASHLIGHT
 struct Spotlight
 {
 	vec3 position;
@@ -76,7 +152,6 @@ struct Spotlight
 	float cos_outer_cone;
 	vec3 diffuse;
 	vec3 specular;
-	int on;
 
 	float constant;
 	float linear;
@@ -86,7 +161,7 @@ uniform Spotlight u_spotlight;
 vec4 calcSpotLightColor(Spotlight spotlight, vec3 normal, vec3 fragment_position, vec3 frag2camera)
 {
 	vec3 frag2light = normalize(spotlight.position - fragment_position);
-    vec4 diffuse = vec4(u_spotlight.diffuse * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * texture(u_material.textura, o_texture_coordinate);
+    vec4 diffuse = vec4(u_spotlight.diffuse * max(dot(normal, frag2light), 0.0f), u_diffuse_alpha) * albedo;
 	vec3 specular = u_spotlight.specular * u_material.specular * pow(max(dot(normal, normalize(frag2light + frag2camera)), 0.0f), u_material.shininess);
 	float d = length(spotlight.position - fragment_position);
 	float attenuation = 1.0f / (spotlight.constant + spotlight.linear * d + spotlight.exponent * (d * d));
@@ -95,6 +170,7 @@ vec4 calcSpotLightColor(Spotlight spotlight, vec3 normal, vec3 fragment_position
 	specular *= attenuation * spotIntensity;	
 	return (diffuse + vec4(specular, 0.0f));
 }
+#endif
 
 // === Main ===
 void main()
@@ -102,19 +178,36 @@ void main()
 	vec3 normal = normalize(o_normal);
 	vec3 frag2camera = normalize(u_camera_position - o_fragment_position);
 	vec4 out_color = vec4(0.0f);
+#ifdef TEXTURED
+	if (u_texture_index == VIRTUAL_TEXTURE_INDEX) albedo = sampleVirtualTexture(o_fragment_position);
+	else albedo = sampleTexture(o_texture_coordinate);
+#else
+	albedo = vec4(1.0f);
+#endif
 
 	// Ambient light
-	vec4 ambient = vec4(u_material.ambient, u_ambient_alpha) * texture(u_material.textura, o_texture_coordinate);
+	vec4 ambient = vec4(u_material.ambient, u_ambient_alpha) * albedo;
 
 	// Directional light
 	out_color += calcDirectionalLightColor(u_directional_light, normal, frag2camera);
 
 	// Point lights
-	for (int i = 0; i < MAX_POINT_LIGHTS; i++) if (u_point_lights[i].on == 1) out_color += calcPointLightColor(u_point_lights[i], normal, o_fragment_position, frag2camera);  
+	uvec2 cluster = clusters[getCluster()];
+	for (uint i = cluster.x; i < cluster.x + cluster.y; i++) out_color += calcPointLightColor(lights[light_indices[i]], normal, o_fragment_position, frag2camera);
 
 	// Spotlight
-	if (u_spotlight.on == 1) out_color += calcSpotLightColor(u_spotlight, normal, o_fragment_position, frag2camera);
+#ifdef FLASHLIGHT
+	out_color += calcSpotLightColor(u_spotlight, normal, o_fragment_position, frag2camera);
+#endif
 
 	// Amen
 	frag_color = ambient + out_color;
+
+	// OIT :: https://jcgt.org/published/0002/02/09/ (eq. 10)
+	if (u_oit == 1) {
+		float alpha = clamp(frag_color.a, 0.0f, 1.0f);
+		float weight = clamp(pow(min(1.0f, alpha * 10.0f) + 0.01f, 3.0f) * 1e8 * pow(1.0f - gl_FragCoord.z * 0.9f, 3.0f), 1e-2, 3e3);
+		frag_color = vec4(frag_color.rgb * alpha, alpha) * weight;
+		frag_reveal = alpha;
+	}
 }
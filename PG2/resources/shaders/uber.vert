@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 // Inspired by "lighting_dir_point_spot.vert" by Steve Jones, Game Institute
 
@@ -8,23 +8,25 @@ layout (location = 1) in vec3 a_normal;
 layout (location = 2) in vec2 a_texture_coordinate;
 
 // Matrices
-uniform mat4 u_mx_model;         // Object local coor space -> World space
-uniform mat4 u_mx_view;          // World space -> Camera space
-uniform mat4 u_mx_projection;    // Camera space -> Screen
+uniform mat4 u_mx_model;            // Object local coor space -> World space
+uniform mat3 u_mx_normal;           // transpose(inverse(u_mx_model)), precomputed on CPU
+uniform mat4 u_mx_view_projection;  // World space -> Screen
 
 // VS -> FS
 out vec3 o_fragment_position;
 out vec3 o_normal;
 out vec2 o_texture_coordinate;
 
+invariant gl_Position; // Same depth as in depth.vert, so GL_EQUAL depth test works after the depth pre-pass
+
 void main()
 {
-    o_fragment_position = vec3(u_mx_model * a_position);
+    vec4 world_position = u_mx_model * a_position;
+    o_fragment_position = vec3(world_position);
 
-    // https://computergraphics.stackexchange.com/questions/1502/why-is-the-transposed-inverse-of-the-model-view-matrix-used-to-transform-the-nor
-    o_normal = mat3(transpose(inverse(u_mx_model))) * a_normal;
+    o_normal = u_mx_normal * a_normal;
 
     o_texture_coordinate = a_texture_coordinate;
 
-    gl_Position = u_mx_projection * u_mx_view * u_mx_model * a_position;
+    gl_Position = u_mx_view_projection * world_position;
 }